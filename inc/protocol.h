@@ -1,6 +1,74 @@
-#ifndef _PROTOCOL_H_
-#define _PROTOCOL_H_
-
-/* TODO */
-
-#endif /* _PROTOCOL_H_ */
\ No newline at end of file
+#ifndef _PROTOCOL_H_
+#define _PROTOCOL_H_
+
+#include <stdint.h>
+
+/*
+ * Text protocol: every request and every reply is one line terminated by
+ * PROTOCOL_EOL (an optional '\r' before it is ignored). A client may send
+ * any number of requests at once (pipelining), the replies are sent back
+ * in the order of the requests.
+ */
+
+/** end of a request or reply line */
+#define PROTOCOL_EOL            '\n'
+
+/** maximum length of a request line, including the line end */
+#define PROTOCOL_MAX_LINE_LEN   2048u
+
+/*
+ * Binary protocol: a client selects it by sending the hello (magic byte
+ * and version) as the first bytes of the connection, the server answers
+ * with a hello of the version it speaks. Text requests start with a
+ * letter, so the magic byte can't be mistaken for one.
+ *
+ * Afterwards every request and reply is a frame: a PROTOCOL_Header
+ * followed by 'keyLen' bytes of key and 'valLen' bytes of value. The
+ * replies are sent in the order of the requests, they carry the opcode
+ * and the request id of their request:
+ *
+ *  GET  key           -> status, value (PROTOCOL_ST_OK only)
+ *  PUT  key, value    -> status
+ *  SAVE               -> status
+ *  BYE                -> (the server closes the connection once the replies
+ *                         of the earlier requests have been sent)
+ */
+
+#define PROTOCOL_BIN_MAGIC      0x80u
+#define PROTOCOL_BIN_VERSION    1u
+#define PROTOCOL_HELLO_LEN      2u
+
+/** request opcodes */
+#define PROTOCOL_OP_GET         1u
+#define PROTOCOL_OP_PUT         2u
+#define PROTOCOL_OP_SAVE        3u
+#define PROTOCOL_OP_BYE         4u
+
+/** reply status codes */
+#define PROTOCOL_ST_OK              0u
+#define PROTOCOL_ST_KEY_EMPTY       1u
+#define PROTOCOL_ST_KEY_INVALID     2u
+#define PROTOCOL_ST_KEY_TOO_LONG    3u
+#define PROTOCOL_ST_KEY_NOT_FOUND   4u
+#define PROTOCOL_ST_KEY_EXISTS      5u
+#define PROTOCOL_ST_VAL_INVALID     6u  /**< value contains a line end or a zero */
+#define PROTOCOL_ST_VAL_TOO_LONG    7u
+#define PROTOCOL_ST_BUSY            8u  /**< snapshot is already in progress */
+#define PROTOCOL_ST_BAD_REQUEST     9u  /**< unknown opcode */
+#define PROTOCOL_ST_ERROR           10u
+
+/**
+ * Header of a binary frame
+ */
+typedef struct PROTOCOL_Header_TAG
+{
+    uint8_t opcode;         /**< PROTOCOL_OP_xxx */
+    uint8_t status;         /**< PROTOCOL_ST_xxx in replies, 0 in requests */
+    uint8_t keyLen;         /**< length of the key after the header */
+    uint8_t valLen;         /**< length of the value after the key */
+    uint32_t requestId;     /**< chosen by the client, echoed unchanged in the reply */
+} PROTOCOL_Header;
+
+_Static_assert(sizeof(PROTOCOL_Header) == 8, "binary frame header must be 8 bytes");
+
+#endif /* _PROTOCOL_H_ */
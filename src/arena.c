@@ -0,0 +1,157 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+
+/**************************************************************/
+/* ------------------- type declarations -------------------- */
+/**************************************************************/
+
+/**
+ * header of a chunk, stored at the beginning of the mapped memory
+ */
+struct ARENA_Chunk_TAG
+{
+    struct ARENA_Chunk_TAG* next;
+    size_t size;            /**< size of the mapping including the header */
+    size_t used;            /**< offset of the first free byte */
+};
+
+/**************************************************************/
+/* ------------------- function prototypes ------------------ */
+/**************************************************************/
+
+static ARENA_Chunk* newChunk( ARENA_Arena* arena, size_t minSize );
+
+/**************************************************************/
+/* ------------------- local functions ---------------------- */
+/**************************************************************/
+
+/**
+ * @brief Maps a new chunk and pushes it to the front of the chunk list
+ *
+ * Chunks are anonymous mappings, so their pages are zero filled and
+ * only backed by physical memory when they are first touched.
+ *
+ * @param[in]  arena
+ * @param[in]  minSize minimum usable size of the chunk
+ * @return     the new chunk
+ *             NULL if the mapping failed
+ */
+static ARENA_Chunk* newChunk( ARENA_Arena* arena, size_t minSize )
+{
+    size_t size = minSize + sizeof(ARENA_Chunk);
+
+    if (size < arena->chunkSize)
+    {
+        size = arena->chunkSize;
+    }
+
+    ARENA_Chunk* chunk = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (chunk == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    chunk->next = arena->chunks;
+    chunk->size = size;
+    chunk->used = sizeof(ARENA_Chunk);
+
+    arena->chunks = chunk;
+    arena->reserved += size;
+
+    return chunk;
+}
+
+/**************************************************************/
+/* ------------------- module interfaces -------------------- */
+/**************************************************************/
+
+/**
+ * @brief Initializes an empty arena
+ *
+ * @param[in]  arena
+ * @param[in]  chunkSize minimum size of the chunks (larger allocations get their own chunk)
+ * @return     none
+ */
+void ARENA_Init( ARENA_Arena* arena, size_t chunkSize )
+{
+    arena->chunks = NULL;
+    arena->chunkSize = chunkSize;
+    arena->reserved = 0;
+}
+
+/**
+ * @brief Allocates zero filled memory from the arena
+ *
+ * The memory is taken from the newest chunk, if it doesn't fit,
+ * a new chunk is mapped.
+ *
+ * @param[in]  arena
+ * @param[in]  size number of bytes
+ * @param[in]  align alignment of the memory (power of two, at most the page size)
+ * @return     pointer to the allocated memory
+ *             NULL if the memory can't be reserved
+ */
+void* ARENA_Alloc( ARENA_Arena* arena, size_t size, size_t align )
+{
+    ARENA_Chunk* chunk = arena->chunks;
+    size_t offset = 0;
+
+    if (chunk != NULL)
+    {
+        offset = (chunk->used + align - 1) & ~(align - 1);
+    }
+
+    if ((chunk == NULL) || (offset + size > chunk->size))
+    {
+        /* worst case padding is needed after the header */
+        if ((chunk = newChunk(arena, size + align)) == NULL)
+        {
+            return NULL;
+        }
+        offset = (chunk->used + align - 1) & ~(align - 1);
+    }
+
+    chunk->used = offset + size;
+
+    return (uint8_t*) chunk + offset;
+}
+
+/**
+ * @brief Releases every chunk of the arena at once
+ *
+ * @param[in]  arena
+ * @return     none
+ */
+void ARENA_Release( ARENA_Arena* arena )
+{
+    ARENA_Chunk* chunk = arena->chunks;
+
+    while (chunk)
+    {
+        ARENA_Chunk* next = chunk->next;
+
+        munmap(chunk, chunk->size);
+        chunk = next;
+    }
+
+    arena->chunks = NULL;
+    arena->reserved = 0;
+}
@@ -0,0 +1,40 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+/** default size of the memory chunks requested from the OS */
+#define ARENA_DEFAULT_CHUNK_SIZE    (1024u * 1024u)
+
+/**
+ * Bump allocator: memory is carved from large chunks and it can only be
+ * released all at once. Objects with the same lifetime (a generation)
+ * are allocated from the same arena and dropped together.
+ */
+typedef struct ARENA_Chunk_TAG ARENA_Chunk;
+
+typedef struct ARENA_Arena_TAG
+{
+    ARENA_Chunk* chunks;    /**< list of chunks, the newest first */
+    size_t chunkSize;       /**< minimum size of a new chunk */
+    size_t reserved;        /**< total size of the chunks in bytes */
+} ARENA_Arena;
+
+/**
+ * Initializes an empty arena, no memory is reserved until the first allocation
+ */
+void ARENA_Init( ARENA_Arena* arena, size_t chunkSize );
+
+/**
+ * return values:
+ *  pointer to the allocated memory (zero filled, aligned to 'align')
+ *  NULL if the memory can't be reserved
+ */
+void* ARENA_Alloc( ARENA_Arena* arena, size_t size, size_t align );
+
+/**
+ * Returns every chunk of the arena to the OS, the arena can be reused afterwards
+ */
+void ARENA_Release( ARENA_Arena* arena );
+
+#endif /* _ARENA_H_ */
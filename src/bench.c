@@ -0,0 +1,1169 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+
+#include "protocol.h"
+#include "keyregistry.h"
+#include "histogram.h"
+#include "bench.h"
+
+/**************************************************************/
+/* ------------------- symbolic constants ------------------- */
+/**************************************************************/
+
+#define BENCH_IN_BUF_SIZE       8192u
+#define BENCH_MAX_REQUEST_LEN   64u
+#define BENCH_MAX_EVENTS        64
+#define BENCH_NS_PER_SEC        1000000000ull
+#define BENCH_NS_PER_MS         1000000ull
+
+/* replies still awaited after the end of the run */
+#define BENCH_DRAIN_NS          (2u * BENCH_NS_PER_SEC)
+
+/* defaults of the configuration */
+#define BENCH_DEFAULT_CONNECTIONS   16u
+#define BENCH_DEFAULT_THREADS       4u
+#define BENCH_DEFAULT_DURATION      10u
+#define BENCH_DEFAULT_GET_PERCENT   90u
+#define BENCH_DEFAULT_KEYS          100000u
+#define BENCH_DEFAULT_ZIPF_THETA    0.99
+
+/**************************************************************/
+/* ------------------- type declarations -------------------- */
+/**************************************************************/
+
+/**
+ * connection of a load generator thread
+ */
+typedef struct BenchConn_TAG
+{
+    int sock;
+    uint32_t inFlight;                      /**< requests waiting for their reply */
+    uint32_t head;                          /**< oldest request in flight */
+    uint64_t nextSend;                      /**< scheduled send time of the next request (open loop) */
+    uint64_t sendTime[BENCH_MAX_DEPTH];     /**< (scheduled) send time of the requests in flight (ring) */
+    uint8_t opcode[BENCH_MAX_DEPTH];        /**< PROTOCOL_OP_GET or PROTOCOL_OP_PUT */
+    size_t inLen;                           /**< received, not yet processed bytes */
+    char in[BENCH_IN_BUF_SIZE];
+} BenchConn;
+
+/**
+ * load generator thread, it drives its own connections
+ */
+typedef struct BenchThread_TAG
+{
+    pthread_t thread;
+    const BENCH_Config* config;
+    BenchConn* conns;
+    uint32_t nrOfConns;
+    uint32_t depth;                         /**< max requests in flight on a connection */
+    uint32_t inFlight;                      /**< requests in flight on all connections */
+    uint64_t rng;                           /**< state of the random generator */
+    uint64_t nrOfGets;
+    uint64_t nrOfHits;                      /**< GETs of an existing key */
+    uint64_t nrOfPuts;
+    uint64_t nrOfPutErrors;
+    uint64_t nrOfValues;                    /**< the value of a PUT is unique */
+    uint64_t nrOfUnsent;                    /**< scheduled requests not sent till the end (open loop) */
+    uint64_t nrOfUnanswered;                /**< requests without reply till the end */
+    uint64_t lastReply;                     /**< time of the last reply */
+    uint8_t retVal;
+    HIST_Histogram latency;                 /**< latency of the requests in nanoseconds */
+} BenchThread;
+
+/**************************************************************/
+/* ------------------- module local variables --------------- */
+/**************************************************************/
+
+/* keys sampled from the registry file */
+static char* keyFileData = NULL;
+static const char** fileKeys = NULL;
+static uint8_t* fileKeyLens = NULL;
+static uint32_t nrOfFileKeys = 0;
+
+/* constants of the zipf generator */
+static double zipfZetaN;
+static double zipfAlpha;
+static double zipfEta;
+
+/* no request is sent (closed loop) or scheduled (open loop) after the end of the run,
+ * it is moved to 0 (atomically) if the run has to stop at once */
+static uint64_t runEnd;
+
+/* time between the requests of a connection in open loop, 0 in closed loop */
+static uint64_t sendInterval;
+
+/* epoll_pwait2() is not supported (Linux < 5.11), the thread waits by pselect() */
+static __thread _Bool noPwait2 = false;
+
+/**************************************************************/
+/* ------------------- function prototypes ------------------ */
+/**************************************************************/
+
+static uint64_t nowNs( void );
+static uint64_t nextRandom( uint64_t* state );
+static double nextUniform( uint64_t* state );
+static uint8_t loadKeyFile( const char* fileName );
+static void initZipf( uint32_t nrOfKeys, double theta );
+static uint32_t nextKeyIndex( BenchThread* thread );
+static size_t formatRequest( BenchThread* thread, BenchConn* conn, char* buf, uint64_t sendTime );
+static _Bool sendAll( int sock, const char* buf, size_t len );
+static uint8_t connectServer( const BENCH_Config* config, const struct addrinfo* addr, int* sock );
+static _Bool fillPipeline( BenchThread* thread, BenchConn* conn );
+static size_t nextReply( const BenchThread* thread, const BenchConn* conn, size_t pos, _Bool* success );
+static void processReplies( BenchThread* thread, BenchConn* conn );
+static uint64_t nextWakeUp( const BenchThread* thread, uint64_t now );
+static _Bool hasBacklog( const BenchConn* conn );
+static int waitEvents( int epollFd, struct epoll_event* events, uint64_t timeoutNs );
+static void recordMissing( BenchThread* thread, uint64_t stop );
+static void* benchTask( void* arg );
+static void printReport( const BENCH_Config* config, BenchThread* threads, uint32_t nrOfThreads, uint64_t elapsed );
+static uint8_t writePercentiles( const char* fileName, const HIST_Histogram* latency );
+
+/**************************************************************/
+/* ------------------- local functions ---------------------- */
+/**************************************************************/
+
+/**
+ * @brief Returns the monotonic time
+ *
+ * @return     nanoseconds
+ */
+static uint64_t nowNs( void )
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * BENCH_NS_PER_SEC + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * @brief Returns the next number of a xorshift64* generator
+ *
+ * @param[in]  state state of the generator (not zero)
+ * @return     random number
+ */
+static uint64_t nextRandom( uint64_t* state )
+{
+    uint64_t x = *state;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+/**
+ * @brief Returns a random number uniformly distributed in [0, 1)
+ *
+ * @param[in]  state state of the generator
+ * @return     random number
+ */
+static double nextUniform( uint64_t* state )
+{
+    return (double)(nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief Reads the keys of a registry file (the first word of each line)
+ *
+ * @param[in]  fileName
+ * @return     BENCH_OK
+ *             BENCH_ERR_KEYS
+ *             BENCH_ERR_NO_MEM
+ */
+static uint8_t loadKeyFile( const char* fileName )
+{
+    FILE* file = fopen(fileName, "r");
+    long size;
+    uint32_t capacity = 0;
+    char* line;
+
+    if (file == NULL)
+    {
+        return BENCH_ERR_KEYS;
+    }
+
+    if ((fseek(file, 0, SEEK_END) != 0) || ((size = ftell(file)) < 0) || (fseek(file, 0, SEEK_SET) != 0))
+    {
+        fclose(file);
+        return BENCH_ERR_KEYS;
+    }
+
+    if ((keyFileData = malloc((size_t) size + 1)) == NULL)
+    {
+        fclose(file);
+        return BENCH_ERR_NO_MEM;
+    }
+
+    size = (long) fread(keyFileData, 1, (size_t) size, file);
+    keyFileData[size] = '\0';
+    fclose(file);
+
+    /* every line is a key, the words are cut in place */
+    for (line = strtok(keyFileData, "\n"); line != NULL; line = strtok(NULL, "\n"))
+    {
+        size_t len = strcspn(line, " \t\r");
+
+        if ((len == 0) || (len > KREG_MAX_KEY_LEN))
+        {
+            continue;
+        }
+
+        if (nrOfFileKeys == capacity)
+        {
+            capacity = (capacity == 0) ? 1024u : capacity * 2u;
+            fileKeys = realloc(fileKeys, capacity * sizeof(*fileKeys));
+            fileKeyLens = realloc(fileKeyLens, capacity * sizeof(*fileKeyLens));
+
+            if ((fileKeys == NULL) || (fileKeyLens == NULL))
+            {
+                return BENCH_ERR_NO_MEM;
+            }
+        }
+
+        fileKeys[nrOfFileKeys] = line;
+        fileKeyLens[nrOfFileKeys] = (uint8_t) len;
+        nrOfFileKeys++;
+    }
+
+    return (nrOfFileKeys > 0) ? BENCH_OK : BENCH_ERR_KEYS;
+}
+
+/**
+ * @brief Calculates the constants of the zipf generator
+ *
+ * The generator of Gray et al. ("Quickly generating billion-record
+ * synthetic databases") is used: the zeta constant is summed once,
+ * then every key costs one pow().
+ *
+ * @param[in]  nrOfKeys size of the key space
+ * @param[in]  theta skew (0 < theta < 1)
+ * @return     none
+ */
+static void initZipf( uint32_t nrOfKeys, double theta )
+{
+    double zeta2 = 1.0 + pow(0.5, theta);
+
+    zipfZetaN = 0.0;
+    for (uint32_t i = 1; i <= nrOfKeys; i++)
+    {
+        zipfZetaN += 1.0 / pow((double) i, theta);
+    }
+
+    zipfAlpha = 1.0 / (1.0 - theta);
+    zipfEta = (1.0 - pow(2.0 / (double) nrOfKeys, 1.0 - theta)) / (1.0 - zeta2 / zipfZetaN);
+}
+
+/**
+ * @brief Returns the index of the next key by the configured distribution
+ *
+ * With zipf, the key 0 is the most popular one.
+ *
+ * @param[in]  thread
+ * @return     index of the key
+ */
+static uint32_t nextKeyIndex( BenchThread* thread )
+{
+    const BENCH_Config* config = thread->config;
+
+    switch (config->keyDist)
+    {
+        case BENCH_KEYS_ZIPF:
+        {
+            double u = nextUniform(&thread->rng);
+            double uz = u * zipfZetaN;
+            uint32_t idx;
+
+            if (uz < 1.0)
+            {
+                return 0;
+            }
+            if (uz < 1.0 + pow(0.5, config->zipfTheta))
+            {
+                return 1;
+            }
+
+            idx = (uint32_t)((double) config->nrOfKeys * pow(zipfEta * u - zipfEta + 1.0, zipfAlpha));
+
+            return (idx < config->nrOfKeys) ? idx : config->nrOfKeys - 1;
+        }
+
+        case BENCH_KEYS_FILE:
+            return (uint32_t)(nextRandom(&thread->rng) % nrOfFileKeys);
+
+        default:
+            return (uint32_t)(nextRandom(&thread->rng) % config->nrOfKeys);
+    }
+}
+
+/**
+ * @brief Formats the next request of a connection and puts it in flight
+ *
+ * @param[in]  thread
+ * @param[in]  conn
+ * @param[out] buf at least BENCH_MAX_REQUEST_LEN bytes
+ * @param[in]  sendTime the latency of the request is measured from here
+ * @return     length of the request
+ */
+static size_t formatRequest( BenchThread* thread, BenchConn* conn, char* buf, uint64_t sendTime )
+{
+    const BENCH_Config* config = thread->config;
+    uint32_t keyIdx = nextKeyIndex(thread);
+    uint8_t opcode = ((nextRandom(&thread->rng) % 100u) < config->getPercent) ? PROTOCOL_OP_GET : PROTOCOL_OP_PUT;
+    uint32_t slot = (conn->head + conn->inFlight) % BENCH_MAX_DEPTH;
+    char keyBuf[16];
+    char valBuf[24];
+    const char* key;
+    int keyLen;
+    int valLen = 0;
+    size_t len;
+
+    if (config->keyDist == BENCH_KEYS_FILE)
+    {
+        key = fileKeys[keyIdx];
+        keyLen = fileKeyLens[keyIdx];
+    }
+    else
+    {
+        keyLen = sprintf(keyBuf, "key%u", keyIdx);
+        key = keyBuf;
+    }
+
+    if (opcode == PROTOCOL_OP_PUT)
+    {
+        valLen = sprintf(valBuf, "v%llu", (unsigned long long) thread->nrOfValues++);
+    }
+
+    if (config->binary)
+    {
+        PROTOCOL_Header header = { opcode, 0, (uint8_t) keyLen, (uint8_t) valLen, slot };
+
+        memcpy(buf, &header, sizeof(header));
+        memcpy(buf + sizeof(header), key, keyLen);
+        memcpy(buf + sizeof(header) + keyLen, valBuf, valLen);
+        len = sizeof(header) + keyLen + valLen;
+    }
+    else if (opcode == PROTOCOL_OP_PUT)
+    {
+        len = (size_t) sprintf(buf, "PUT %.*s %.*s\n", keyLen, key, valLen, valBuf);
+    }
+    else
+    {
+        len = (size_t) sprintf(buf, "GET %.*s\n", keyLen, key);
+    }
+
+    conn->sendTime[slot] = sendTime;
+    conn->opcode[slot] = opcode;
+    conn->inFlight++;
+    thread->inFlight++;
+
+    return len;
+}
+
+/**
+ * @brief Writes a whole buffer to a socket
+ *
+ * @param[in]  sock
+ * @param[in]  buf
+ * @param[in]  len
+ * @return     true if everything has been written
+ */
+static _Bool sendAll( int sock, const char* buf, size_t len )
+{
+    while (len > 0)
+    {
+        ssize_t nbytes = send(sock, buf, len, MSG_NOSIGNAL);
+
+        if (nbytes < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        buf += nbytes;
+        len -= (size_t) nbytes;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Connects to the server (and selects the binary protocol if configured)
+ *
+ * @param[in]  config
+ * @param[in]  addr resolved address of the server
+ * @param[out] sock connected socket
+ * @return     BENCH_OK
+ *             BENCH_ERR_CONNECT
+ */
+static uint8_t connectServer( const BENCH_Config* config, const struct addrinfo* addr, int* sock )
+{
+    int one = 1;
+
+    if ((*sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol)) < 0)
+    {
+        return BENCH_ERR_CONNECT;
+    }
+
+    /* the requests of a pipeline are written at once, they must not wait for each other */
+    setsockopt(*sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(*sock, addr->ai_addr, addr->ai_addrlen) < 0)
+    {
+        close(*sock);
+        return BENCH_ERR_CONNECT;
+    }
+
+    if (config->binary)
+    {
+        const char hello[PROTOCOL_HELLO_LEN] = { (char) PROTOCOL_BIN_MAGIC, (char) PROTOCOL_BIN_VERSION };
+        char answer[PROTOCOL_HELLO_LEN];
+
+        if (!sendAll(*sock, hello, sizeof(hello))
+            || (recv(*sock, answer, sizeof(answer), MSG_WAITALL) != sizeof(answer))
+            || (memcmp(hello, answer, sizeof(hello)) != 0))
+        {
+            fprintf(stderr, "The server doesn't speak the binary protocol\n");
+            close(*sock);
+            return BENCH_ERR_CONNECT;
+        }
+    }
+
+    return BENCH_OK;
+}
+
+/**
+ * @brief Sends the new requests of a connection
+ *
+ * Closed loop: requests are sent till the configured number is in flight,
+ * but none after the end of the run.
+ *
+ * Open loop: the requests whose scheduled time has come are sent, as far
+ * as the configured number in flight allows. A request which has to wait
+ * for a free slot keeps its scheduled time, so the wait counts in its
+ * latency (otherwise a stalled server would hide its own stall by
+ * delaying the requests which would have measured it).
+ *
+ * @param[in]  thread
+ * @param[in]  conn
+ * @return     false if the connection is broken
+ */
+static _Bool fillPipeline( BenchThread* thread, BenchConn* conn )
+{
+    char buf[BENCH_MAX_DEPTH * BENCH_MAX_REQUEST_LEN];
+    size_t len = 0;
+    uint64_t now = nowNs();
+    uint64_t end = __atomic_load_n(&runEnd, __ATOMIC_RELAXED);
+
+    if (sendInterval == 0)
+    {
+        if (now >= end)
+        {
+            return true;
+        }
+
+        while (conn->inFlight < thread->depth)
+        {
+            len += formatRequest(thread, conn, buf + len, now);
+        }
+    }
+    else
+    {
+        while ((conn->inFlight < thread->depth) && (conn->nextSend <= now) && (conn->nextSend < end))
+        {
+            len += formatRequest(thread, conn, buf + len, conn->nextSend);
+            conn->nextSend += sendInterval;
+        }
+    }
+
+    return (len == 0) || sendAll(conn->sock, buf, len);
+}
+
+/**
+ * @brief Finds the end of the next complete reply of a connection
+ *
+ * @param[in]  thread
+ * @param[in]  conn
+ * @param[in]  pos start of the reply in the input
+ * @param[out] success the request has succeeded (GET: the key exists)
+ * @return     end of the reply, 0 if it is incomplete
+ */
+static size_t nextReply( const BenchThread* thread, const BenchConn* conn, size_t pos, _Bool* success )
+{
+    if (thread->config->binary)
+    {
+        PROTOCOL_Header reply;
+
+        if (conn->inLen - pos < sizeof(reply))
+        {
+            return 0;
+        }
+
+        memcpy(&reply, conn->in + pos, sizeof(reply));
+        if (conn->inLen - pos < sizeof(reply) + reply.keyLen + reply.valLen)
+        {
+            return 0;
+        }
+
+        *success = (reply.status == PROTOCOL_ST_OK);
+
+        return pos + sizeof(reply) + reply.keyLen + reply.valLen;
+    }
+    else
+    {
+        const char* lineEnd = memchr(conn->in + pos, PROTOCOL_EOL, conn->inLen - pos);
+
+        if (lineEnd == NULL)
+        {
+            return 0;
+        }
+
+        /* the reply of a found or stored key starts with the key, an error doesn't */
+        *success = (conn->in[pos] == '[');
+
+        return (size_t)(lineEnd - conn->in) + 1;
+    }
+}
+
+/**
+ * @brief Records the latency of every complete reply of a connection
+ *
+ * The replies come in the order of the requests, so each one belongs to
+ * the oldest request in flight.
+ *
+ * @param[in]  thread
+ * @param[in]  conn
+ * @return     none
+ */
+static void processReplies( BenchThread* thread, BenchConn* conn )
+{
+    uint64_t now = nowNs();
+    size_t pos = 0;
+    size_t end;
+    _Bool success;
+
+    while ((conn->inFlight > 0) && ((end = nextReply(thread, conn, pos, &success)) != 0))
+    {
+        HIST_Record(&thread->latency, now - conn->sendTime[conn->head]);
+
+        if (conn->opcode[conn->head] == PROTOCOL_OP_GET)
+        {
+            thread->nrOfGets++;
+            thread->nrOfHits += success;
+        }
+        else
+        {
+            thread->nrOfPuts++;
+            thread->nrOfPutErrors += !success;
+        }
+
+        conn->head = (conn->head + 1u) % BENCH_MAX_DEPTH;
+        conn->inFlight--;
+        thread->inFlight--;
+        thread->lastReply = now;
+        pos = end;
+    }
+
+    memmove(conn->in, conn->in + pos, conn->inLen - pos);
+    conn->inLen -= pos;
+}
+
+/**
+ * @brief Returns when the thread has to send or stop next
+ *
+ * @param[in]  thread
+ * @param[in]  now
+ * @return     the earliest scheduled request which can be sent (open loop),
+ *             the end of the run or the end of the drain time
+ */
+static uint64_t nextWakeUp( const BenchThread* thread, uint64_t now )
+{
+    uint64_t end = __atomic_load_n(&runEnd, __ATOMIC_RELAXED);
+    uint64_t wakeUp = (now < end) ? end : end + BENCH_DRAIN_NS;
+
+    if (sendInterval != 0)
+    {
+        for (uint32_t i = 0; i < thread->nrOfConns; i++)
+        {
+            const BenchConn* conn = &thread->conns[i];
+
+            if ((conn->inFlight < thread->depth) && (conn->nextSend < end) && (conn->nextSend < wakeUp))
+            {
+                wakeUp = conn->nextSend;
+            }
+        }
+    }
+
+    return wakeUp;
+}
+
+/**
+ * @brief Returns whether a connection has scheduled requests not sent yet
+ *
+ * @param[in]  conn
+ * @return     true in open loop if a request is overdue
+ */
+static _Bool hasBacklog( const BenchConn* conn )
+{
+    return (sendInterval != 0) && (conn->nextSend < __atomic_load_n(&runEnd, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief Waits for the replies till a timeout given in nanoseconds
+ *
+ * The schedule of the open loop needs a finer timeout than milliseconds,
+ * so epoll_pwait2() is used. If the kernel doesn't have it, the epoll
+ * descriptor itself is waited for by pselect() (it is readable when an event
+ * is ready), then the events are taken by epoll_wait() without blocking.
+ *
+ * @param[in]  epollFd
+ * @param[out] events
+ * @param[in]  timeoutNs
+ * @return     number of events, -1 in case of error
+ */
+static int waitEvents( int epollFd, struct epoll_event* events, uint64_t timeoutNs )
+{
+    struct timespec timeout = { (time_t)(timeoutNs / BENCH_NS_PER_SEC), (long)(timeoutNs % BENCH_NS_PER_SEC) };
+    fd_set readFds;
+    int nrOfEvents;
+
+    if (!noPwait2)
+    {
+        nrOfEvents = epoll_pwait2(epollFd, events, BENCH_MAX_EVENTS, &timeout, NULL);
+        if ((nrOfEvents >= 0) || (errno != ENOSYS))
+        {
+            return ((nrOfEvents < 0) && (errno == EINTR)) ? 0 : nrOfEvents;
+        }
+        noPwait2 = true;
+    }
+
+    FD_ZERO(&readFds);
+    FD_SET(epollFd, &readFds);
+
+    if ((nrOfEvents = pselect(epollFd + 1, &readFds, NULL, NULL, &timeout, NULL)) > 0)
+    {
+        nrOfEvents = epoll_wait(epollFd, events, BENCH_MAX_EVENTS, 0);
+    }
+
+    return ((nrOfEvents < 0) && (errno == EINTR)) ? 0 : nrOfEvents;
+}
+
+/**
+ * @brief Records the requests left without reply at the end of the run
+ *
+ * A request not answered (or in open loop not even sent) till the thread
+ * stops is recorded with the latency it has reached by then, so a stalled
+ * server can't hide its stall by leaving requests out of the percentiles
+ * (their real latency is at least that much).
+ *
+ * @param[in]  thread
+ * @param[in]  stop time when the thread stopped waiting
+ * @return     none
+ */
+static void recordMissing( BenchThread* thread, uint64_t stop )
+{
+    uint64_t end = __atomic_load_n(&runEnd, __ATOMIC_RELAXED);
+
+    for (uint32_t i = 0; i < thread->nrOfConns; i++)
+    {
+        const BenchConn* conn = &thread->conns[i];
+
+        for (uint32_t j = 0; j < conn->inFlight; j++)
+        {
+            HIST_Record(&thread->latency, stop - conn->sendTime[(conn->head + j) % BENCH_MAX_DEPTH]);
+        }
+        thread->nrOfUnanswered += conn->inFlight;
+
+        for (uint64_t sendTime = conn->nextSend; hasBacklog(conn) && (sendTime < end); sendTime += sendInterval)
+        {
+            HIST_Record(&thread->latency, stop - sendTime);
+            thread->nrOfUnsent++;
+        }
+    }
+}
+
+/**
+ * @brief Entry point of a load generator thread
+ *
+ * Closed loop: every connection keeps the configured number of requests
+ * in flight, a new request is sent as soon as a reply arrives.
+ *
+ * Open loop: every connection sends its requests by its schedule,
+ * independently of the replies.
+ *
+ * After the end of the run, the replies in flight (and in open loop the
+ * requests scheduled before the end) are still awaited for a while, the
+ * ones still missing then are recorded by recordMissing().
+ *
+ * @param[in]  arg thread
+ * @return     NULL
+ */
+static void* benchTask( void* arg )
+{
+    BenchThread* thread = arg;
+    struct epoll_event events[BENCH_MAX_EVENTS];
+    struct epoll_event event;
+    uint64_t stop;
+    int epollFd;
+
+    /* the default timer slack (50 us) would delay every scheduled request */
+    prctl(PR_SET_TIMERSLACK, 1ul, 0ul, 0ul, 0ul);
+
+    if ((epollFd = epoll_create1(0)) < 0)
+    {
+        thread->retVal = BENCH_ERR_THREAD;
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < thread->nrOfConns; i++)
+    {
+        event.events = EPOLLIN;
+        event.data.ptr = &thread->conns[i];
+
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, thread->conns[i].sock, &event) < 0)
+        {
+            thread->retVal = BENCH_ERR_SERVER;
+            close(epollFd);
+            return NULL;
+        }
+    }
+
+    for (;;)
+    {
+        uint64_t now = nowNs();
+        uint64_t end;
+        uint64_t wakeUp;
+        _Bool backlog = false;
+        int nrOfEvents;
+
+        for (uint32_t i = 0; i < thread->nrOfConns; i++)
+        {
+            if (!fillPipeline(thread, &thread->conns[i]))
+            {
+                thread->retVal = BENCH_ERR_SERVER;
+                close(epollFd);
+                return NULL;
+            }
+            backlog |= hasBacklog(&thread->conns[i]);
+        }
+
+        end = __atomic_load_n(&runEnd, __ATOMIC_RELAXED);
+        if ((now >= end) && (((thread->inFlight == 0) && !backlog) || (now >= end + BENCH_DRAIN_NS)))
+        {
+            stop = now;
+            break;
+        }
+
+        wakeUp = nextWakeUp(thread, now);
+        now = nowNs();
+
+        if ((nrOfEvents = waitEvents(epollFd, events, (wakeUp > now) ? wakeUp - now : 0)) < 0)
+        {
+            thread->retVal = BENCH_ERR_THREAD;
+            close(epollFd);
+            return NULL;
+        }
+
+        for (int i = 0; i < nrOfEvents; i++)
+        {
+            BenchConn* conn = events[i].data.ptr;
+            ssize_t nbytes = recv(conn->sock, conn->in + conn->inLen, sizeof(conn->in) - conn->inLen, MSG_DONTWAIT);
+
+            if ((nbytes < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+            {
+                continue;
+            }
+
+            if (nbytes <= 0)
+            {
+                thread->retVal = BENCH_ERR_SERVER;
+                close(epollFd);
+                return NULL;
+            }
+
+            conn->inLen += (size_t) nbytes;
+            processReplies(thread, conn);
+        }
+    }
+
+    recordMissing(thread, stop);
+
+    close(epollFd);
+
+    return NULL;
+}
+
+/**
+ * @brief Prints the results of the run
+ *
+ * @param[in]  config
+ * @param[in]  threads (their histograms are merged into the first one)
+ * @param[in]  nrOfThreads
+ * @param[in]  elapsed length of the run in nanoseconds
+ * @return     none
+ */
+static void printReport( const BENCH_Config* config, BenchThread* threads, uint32_t nrOfThreads, uint64_t elapsed )
+{
+    HIST_Histogram* latency = &threads[0].latency;
+    uint64_t nrOfGets = threads[0].nrOfGets;
+    uint64_t nrOfHits = threads[0].nrOfHits;
+    uint64_t nrOfPuts = threads[0].nrOfPuts;
+    uint64_t nrOfPutErrors = threads[0].nrOfPutErrors;
+    uint64_t nrOfUnsent = threads[0].nrOfUnsent;
+    uint64_t nrOfUnanswered = threads[0].nrOfUnanswered;
+    double seconds = (double) elapsed / (double) BENCH_NS_PER_SEC;
+
+    for (uint32_t i = 1; i < nrOfThreads; i++)
+    {
+        HIST_Merge(latency, &threads[i].latency);
+        nrOfGets += threads[i].nrOfGets;
+        nrOfHits += threads[i].nrOfHits;
+        nrOfPuts += threads[i].nrOfPuts;
+        nrOfPutErrors += threads[i].nrOfPutErrors;
+        nrOfUnsent += threads[i].nrOfUnsent;
+        nrOfUnanswered += threads[i].nrOfUnanswered;
+    }
+
+    fprintf(stdout, "* %u connections, %u threads, depth %u, GET %u%%, %s protocol, ",
+            config->nrOfConnections, nrOfThreads, threads[0].depth, config->getPercent, config->binary ? "binary" : "text");
+
+    if (config->rate != 0)
+    {
+        fprintf(stdout, "open loop at %u req/s, keys: ", config->rate);
+    }
+    else
+    {
+        fprintf(stdout, "closed loop, keys: ");
+    }
+
+    switch (config->keyDist)
+    {
+        case BENCH_KEYS_ZIPF:
+            fprintf(stdout, "zipf (theta %.2f, %u keys)\n", config->zipfTheta, config->nrOfKeys);
+            break;
+        case BENCH_KEYS_FILE:
+            fprintf(stdout, "%s (%u keys)\n", config->keyFile, nrOfFileKeys);
+            break;
+        default:
+            fprintf(stdout, "uniform (%u keys)\n", config->nrOfKeys);
+            break;
+    }
+
+    fprintf(stdout, "  requests     : %llu in %.2f s, %.0f req/s\n",
+            (unsigned long long)(nrOfGets + nrOfPuts), seconds, (double)(nrOfGets + nrOfPuts) / seconds);
+    fprintf(stdout, "  GET          : %llu (hits %.1f%%)\n",
+            (unsigned long long) nrOfGets, (nrOfGets > 0) ? 100.0 * (double) nrOfHits / (double) nrOfGets : 0.0);
+    fprintf(stdout, "  PUT          : %llu (errors %llu)\n",
+            (unsigned long long) nrOfPuts, (unsigned long long) nrOfPutErrors);
+    if ((nrOfUnsent != 0) || (nrOfUnanswered != 0))
+    {
+        /* these are in the latencies with their wait till the end, their real latency is longer */
+        fprintf(stdout, "  missing      : %llu not sent, %llu not answered till the end (latencies are lower bounds)\n",
+                (unsigned long long) nrOfUnsent, (unsigned long long) nrOfUnanswered);
+    }
+    fprintf(stdout, "  latency (us) : p50 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+            HIST_ValueAtPercentile(latency, 50.0) / 1000.0,
+            HIST_ValueAtPercentile(latency, 99.0) / 1000.0,
+            HIST_ValueAtPercentile(latency, 99.9) / 1000.0,
+            latency->max / 1000.0);
+}
+
+/**
+ * @brief Writes the latency percentile table (in microseconds)
+ *
+ * @param[in]  fileName "-" is the standard output
+ * @param[in]  latency merged histogram of the run
+ * @return     BENCH_OK
+ *             BENCH_ERR_OUTPUT
+ */
+static uint8_t writePercentiles( const char* fileName, const HIST_Histogram* latency )
+{
+    FILE* file = (strcmp(fileName, "-") == 0) ? stdout : fopen(fileName, "w");
+
+    if (file == NULL)
+    {
+        return BENCH_ERR_OUTPUT;
+    }
+
+    HIST_WritePercentiles(latency, file, 1000.0);
+
+    if (file == stdout)
+    {
+        return BENCH_OK;
+    }
+
+    return (fclose(file) == 0) ? BENCH_OK : BENCH_ERR_OUTPUT;
+}
+
+/**************************************************************/
+/* ------------------- module interfaces -------------------- */
+/**************************************************************/
+
+/**
+ * @brief Fills the configuration with the defaults
+ *
+ * @param[out] config
+ * @return     none
+ */
+void BENCH_DefaultConfig( BENCH_Config* config )
+{
+    memset(config, 0, sizeof(*config));
+
+    config->nrOfConnections = BENCH_DEFAULT_CONNECTIONS;
+    config->nrOfThreads = BENCH_DEFAULT_THREADS;
+    config->durationSec = BENCH_DEFAULT_DURATION;
+    config->depth = 0;
+    config->getPercent = BENCH_DEFAULT_GET_PERCENT;
+    config->keyDist = BENCH_KEYS_UNIFORM;
+    config->nrOfKeys = BENCH_DEFAULT_KEYS;
+    config->zipfTheta = BENCH_DEFAULT_ZIPF_THETA;
+}
+
+/**
+ * @brief Parses a key distribution
+ *
+ * @param[out] config
+ * @param[in]  spec "uniform", "zipf", "zipf:THETA" or "file:PATH"
+ * @return     BENCH_OK
+ *             BENCH_ERR_KEYS
+ */
+uint8_t BENCH_ParseKeyDist( BENCH_Config* config, const char* spec )
+{
+    if (strcmp(spec, "uniform") == 0)
+    {
+        config->keyDist = BENCH_KEYS_UNIFORM;
+    }
+    else if (strncmp(spec, "zipf", 4) == 0)
+    {
+        config->keyDist = BENCH_KEYS_ZIPF;
+
+        if (spec[4] == ':')
+        {
+            char* end;
+
+            config->zipfTheta = strtod(spec + 5, &end);
+            if ((end == spec + 5) || (*end != '\0'))
+            {
+                return BENCH_ERR_KEYS;
+            }
+        }
+        else if (spec[4] != '\0')
+        {
+            return BENCH_ERR_KEYS;
+        }
+
+        if ((config->zipfTheta <= 0.0) || (config->zipfTheta >= 1.0))
+        {
+            return BENCH_ERR_KEYS;
+        }
+    }
+    else if ((strncmp(spec, "file:", 5) == 0) && (spec[5] != '\0'))
+    {
+        config->keyDist = BENCH_KEYS_FILE;
+        config->keyFile = spec + 5;
+    }
+    else
+    {
+        return BENCH_ERR_KEYS;
+    }
+
+    return BENCH_OK;
+}
+
+/**
+ * @brief Runs the benchmark
+ *
+ * The connections are opened before the threads are started, so the
+ * connection setup is not measured.
+ *
+ * @param[in]  config
+ * @return     see bench.h
+ */
+uint8_t BENCH_Run( const BENCH_Config* config )
+{
+    struct addrinfo hints;
+    struct addrinfo* addr;
+    char portStr[8];
+    uint32_t nrOfThreads = (config->nrOfThreads < config->nrOfConnections) ? config->nrOfThreads : config->nrOfConnections;
+    uint32_t depth = config->depth;
+    BenchThread* threads;
+    BenchConn* conns;
+    uint8_t retVal = BENCH_OK;
+    uint32_t nrOfOpen = 0;
+    uint32_t nrOfStarted = 0;
+    uint64_t start;
+
+    if (depth == 0)
+    {
+        depth = (config->rate != 0) ? BENCH_MAX_DEPTH : 1u;
+    }
+
+    if ((nrOfThreads == 0) || (depth > BENCH_MAX_DEPTH) || (config->nrOfKeys == 0))
+    {
+        return BENCH_ERR_THREAD;
+    }
+
+    /* every connection gets the same share of the rate */
+    sendInterval = 0;
+    if (config->rate != 0)
+    {
+        sendInterval = (uint64_t) config->nrOfConnections * BENCH_NS_PER_SEC / config->rate;
+        if (sendInterval == 0)
+        {
+            sendInterval = 1;
+        }
+    }
+
+    if (config->keyDist == BENCH_KEYS_FILE)
+    {
+        if ((retVal = loadKeyFile(config->keyFile)) != BENCH_OK)
+        {
+            return retVal;
+        }
+    }
+    else if (config->keyDist == BENCH_KEYS_ZIPF)
+    {
+        initZipf(config->nrOfKeys, config->zipfTheta);
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    sprintf(portStr, "%u", config->port);
+
+    if (getaddrinfo(config->address, portStr, &hints, &addr) != 0)
+    {
+        return BENCH_ERR_CONNECT;
+    }
+
+    threads = calloc(nrOfThreads, sizeof(BenchThread));
+    conns = calloc(config->nrOfConnections, sizeof(BenchConn));
+
+    if ((threads == NULL) || (conns == NULL))
+    {
+        freeaddrinfo(addr);
+        free(threads);
+        free(conns);
+        return BENCH_ERR_NO_MEM;
+    }
+
+    for (nrOfOpen = 0; nrOfOpen < config->nrOfConnections; nrOfOpen++)
+    {
+        if ((retVal = connectServer(config, addr, &conns[nrOfOpen].sock)) != BENCH_OK)
+        {
+            break;
+        }
+    }
+    freeaddrinfo(addr);
+
+    if (retVal == BENCH_OK)
+    {
+        /* the connections are split among the threads in contiguous ranges */
+        for (uint32_t i = 0; i < nrOfThreads; i++)
+        {
+            uint32_t first = (uint32_t)((uint64_t) config->nrOfConnections * i / nrOfThreads);
+            uint32_t last = (uint32_t)((uint64_t) config->nrOfConnections * (i + 1) / nrOfThreads);
+
+            threads[i].config = config;
+            threads[i].conns = &conns[first];
+            threads[i].nrOfConns = last - first;
+            threads[i].depth = depth;
+            threads[i].rng = 0x9E3779B97F4A7C15ull * (i + 1);
+            HIST_Reset(&threads[i].latency);
+        }
+
+        start = nowNs();
+        __atomic_store_n(&runEnd, start + (uint64_t) config->durationSec * BENCH_NS_PER_SEC, __ATOMIC_RELAXED);
+
+        /* the schedules of the connections are staggered, the requests are not sent in bursts */
+        for (uint32_t i = 0; i < config->nrOfConnections; i++)
+        {
+            conns[i].nextSend = start + sendInterval * i / config->nrOfConnections;
+        }
+
+        for (nrOfStarted = 0; nrOfStarted < nrOfThreads; nrOfStarted++)
+        {
+            if (pthread_create(&threads[nrOfStarted].thread, NULL, benchTask, &threads[nrOfStarted]) != 0)
+            {
+                /* the started threads stop at once */
+                __atomic_store_n(&runEnd, 0, __ATOMIC_RELAXED);
+                retVal = BENCH_ERR_THREAD;
+                break;
+            }
+        }
+
+        for (uint32_t i = 0; i < nrOfStarted; i++)
+        {
+            pthread_join(threads[i].thread, NULL);
+
+            if ((retVal == BENCH_OK) && (threads[i].retVal != BENCH_OK))
+            {
+                retVal = threads[i].retVal;
+            }
+        }
+
+        if (retVal == BENCH_OK)
+        {
+            /* the throughput is measured till the last reply, the rest of the drain time is idle */
+            uint64_t end = __atomic_load_n(&runEnd, __ATOMIC_RELAXED);
+
+            for (uint32_t i = 0; i < nrOfThreads; i++)
+            {
+                end = (threads[i].lastReply > end) ? threads[i].lastReply : end;
+            }
+
+            printReport(config, threads, nrOfThreads, end - start);
+
+            if (config->percentileFile != NULL)
+            {
+                retVal = writePercentiles(config->percentileFile, &threads[0].latency);
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < nrOfOpen; i++)
+    {
+        close(conns[i].sock);
+    }
+
+    free(threads);
+    free(conns);
+
+    return retVal;
+}
@@ -0,0 +1,81 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Return values of this module */
+#define BENCH_OK                0u
+#define BENCH_ERR_CONNECT       1u
+#define BENCH_ERR_KEYS          2u
+#define BENCH_ERR_NO_MEM        3u
+#define BENCH_ERR_THREAD        4u
+#define BENCH_ERR_SERVER        5u
+#define BENCH_ERR_OUTPUT        6u
+
+/** key distributions */
+#define BENCH_KEYS_UNIFORM      0u
+#define BENCH_KEYS_ZIPF         1u
+#define BENCH_KEYS_FILE         2u
+
+/** maximum number of requests in flight on a connection */
+#define BENCH_MAX_DEPTH         64u
+
+/**
+ * Parameters of a benchmark run
+ */
+typedef struct BENCH_Config_TAG
+{
+    const char* address;        /**< server host */
+    uint16_t port;              /**< server port */
+    uint32_t nrOfConnections;   /**< connections, spread among the threads */
+    uint32_t nrOfThreads;       /**< load generator threads */
+    uint32_t durationSec;       /**< length of the run */
+    uint32_t depth;             /**< max requests in flight on a connection
+                                     (0: 1 in closed loop, BENCH_MAX_DEPTH in open loop) */
+    uint32_t getPercent;        /**< share of GETs, the rest are PUTs */
+    uint8_t keyDist;            /**< BENCH_KEYS_xxx */
+    uint32_t nrOfKeys;          /**< size of the key space (uniform, zipf) */
+    double zipfTheta;           /**< skew of the zipf distribution (0 < theta < 1) */
+    const char* keyFile;        /**< registry file the keys are sampled from (file) */
+    _Bool binary;               /**< the binary protocol is used instead of the text one */
+    uint32_t rate;              /**< requests per second of all connections (open loop),
+                                     0: a new request is sent when a reply arrives (closed loop) */
+    const char* percentileFile; /**< the latency percentile table is written here (NULL: none) */
+} BENCH_Config;
+
+/**
+ * Fills the configuration with the defaults
+ */
+void BENCH_DefaultConfig( BENCH_Config* config );
+
+/**
+ * Parses a key distribution: "uniform", "zipf", "zipf:THETA" or "file:PATH"
+ *
+ * return values:
+ *  BENCH_OK
+ *  BENCH_ERR_KEYS
+ */
+uint8_t BENCH_ParseKeyDist( BENCH_Config* config, const char* spec );
+
+/**
+ * Drives the server with requests on every connection for the configured
+ * time, then prints the throughput and the latency percentiles to the
+ * standard output
+ *
+ * In open loop, the requests are scheduled at a fixed rate and their
+ * latency is measured from the scheduled send time, so a stalled server
+ * is not hidden by requests which couldn't be sent.
+ *
+ * return values:
+ *  BENCH_OK
+ *  BENCH_ERR_CONNECT
+ *  BENCH_ERR_KEYS (the key file can't be read or it has no key)
+ *  BENCH_ERR_NO_MEM
+ *  BENCH_ERR_THREAD
+ *  BENCH_ERR_SERVER (a connection has been broken during the run)
+ *  BENCH_ERR_OUTPUT (the percentile table can't be written)
+ */
+uint8_t BENCH_Run( const BENCH_Config* config );
+
+#endif /* _BENCH_H_ */
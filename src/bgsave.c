@@ -0,0 +1,245 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "bgsave.h"
+#include "keyregistry.h"
+
+/**************************************************************/
+/* ------------------- module local variables --------------- */
+/**************************************************************/
+
+/* child process writing the snapshot (0 if none), it is read without locking */
+static pid_t savePid = 0;
+
+/* read end of the pipe the child sends its report through */
+static int reportFd = -1;
+
+/* time the parent was blocked in the last fork() */
+static uint64_t lastForkUs = 0;
+
+/**************************************************************/
+/* ------------------- function prototypes ------------------ */
+/**************************************************************/
+
+static uint64_t monotonicUs( void );
+static uint64_t readPrivateDirty( const char* fileName );
+static void saveInChild( const char* fileName, int fd );
+
+/**************************************************************/
+/* ------------------- local functions ---------------------- */
+/**************************************************************/
+
+/**
+ * @brief Returns the monotonic clock in microseconds
+ *
+ * @return     microseconds since an arbitrary point
+ */
+static uint64_t monotonicUs( void )
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+/**
+ * @brief Sums the Private_Dirty fields of a /proc smaps file
+ *
+ * In the child, the pages shared with the parent are counted as shared
+ * until one of the processes writes them, so the private dirty memory is
+ * what has been copied on write since the fork.
+ *
+ * @param[in]  fileName smaps file of the process
+ * @return     private dirty memory in bytes (0 if it is not available)
+ */
+static uint64_t readPrivateDirty( const char* fileName )
+{
+    FILE* fd;
+    char line[256];
+    unsigned long long int kBytes;
+    uint64_t total = 0;
+
+    if ((fd = fopen(fileName, "r")) == NULL)
+    {
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), fd) != NULL)
+    {
+        if (sscanf(line, "Private_Dirty: %llu kB", &kBytes) == 1)
+        {
+            total += kBytes * 1024u;
+        }
+    }
+
+    fclose(fd);
+
+    return total;
+}
+
+/**
+ * @brief Writes the snapshot and reports the result to the parent
+ *
+ * Runs in the child process, it never returns.
+ *
+ * @param[in]  fileName name of the snapshot file
+ * @param[in]  fd write end of the report pipe
+ * @return     none
+ */
+static void saveInChild( const char* fileName, int fd )
+{
+    BGSAVE_Result report;
+    uint64_t start = monotonicUs();
+
+    report.status = KREG_WriteSnapshot(fileName);
+    report.forkUs = 0;
+    report.saveUs = monotonicUs() - start;
+
+    /* smaps_rollup is cheaper, but it is not provided by older kernels */
+    if ((report.cowBytes = readPrivateDirty("/proc/self/smaps_rollup")) == 0)
+    {
+        report.cowBytes = readPrivateDirty("/proc/self/smaps");
+    }
+
+    /* the report is smaller than PIPE_BUF, so it is written at once */
+    if (write(fd, &report, sizeof(report)) != sizeof(report))
+    {
+        report.status = KREG_ERR_SNAP_WRITE;
+    }
+
+    /* don't run the exit handlers of the parent */
+    _exit(report.status);
+}
+
+/**************************************************************/
+/* ------------------- module interfaces -------------------- */
+/**************************************************************/
+
+/**
+ * @brief Starts writing the snapshot of the registry in a child process
+ *
+ * The child gets a copy-on-write image of the parent, so it serializes
+ * the registry as it was at the time of the fork while the parent keeps
+ * serving requests. The child reports the result in its exit status,
+ * the time of the save and the memory copied on write through a pipe.
+ *
+ * @param[in]  fileName name of the snapshot file
+ * @return     BGSAVE_OK
+ *             BGSAVE_ERR_BUSY
+ *             BGSAVE_ERR_FORK
+ */
+uint8_t BGSAVE_Start( const char* fileName )
+{
+    pid_t pid;
+    int fds[2];
+    uint64_t start;
+
+    if (savePid != 0)
+    {
+        return BGSAVE_ERR_BUSY;
+    }
+
+    if (pipe(fds) != 0)
+    {
+        return BGSAVE_ERR_FORK;
+    }
+
+    /* buffered output would be written by both processes */
+    fflush(stdout);
+    fflush(stderr);
+
+    start = monotonicUs();
+
+    /* no update is in progress in any shard, so the image of the child is consistent */
+    KREG_Freeze();
+
+    if ((pid = fork()) < 0)
+    {
+        KREG_Thaw();
+        close(fds[0]);
+        close(fds[1]);
+        return BGSAVE_ERR_FORK;
+    }
+
+    if (pid == 0)
+    {
+        KREG_ThawInChild();
+        close(fds[0]);
+        saveInChild(fileName, fds[1]);
+    }
+
+    KREG_Thaw();
+
+    /* copying the page tables blocks the parent, it grows with the registry */
+    lastForkUs = monotonicUs() - start;
+
+    close(fds[1]);
+    reportFd = fds[0];
+    __atomic_store_n(&savePid, pid, __ATOMIC_RELEASE);
+
+    return BGSAVE_OK;
+}
+
+/**
+ * @brief Returns whether a background save is running
+ *
+ * @return     true if the child process has not been reaped yet
+ */
+_Bool BGSAVE_InProgress( void )
+{
+    return __atomic_load_n(&savePid, __ATOMIC_ACQUIRE) != 0;
+}
+
+/**
+ * @brief Checks whether the background save has finished
+ *
+ * @param[out] result result of the save (only if it has finished)
+ * @return     true if the save has finished
+ */
+_Bool BGSAVE_Poll( BGSAVE_Result* result )
+{
+    int status;
+
+    if ((savePid == 0) || (waitpid(savePid, &status, WNOHANG) != savePid))
+    {
+        return false;
+    }
+
+    __atomic_store_n(&savePid, 0, __ATOMIC_RELEASE);
+
+    /* the child has exited, so its report (if any) is already in the pipe */
+    if (read(reportFd, result, sizeof(*result)) != sizeof(*result))
+    {
+        memset(result, 0, sizeof(*result));
+    }
+    close(reportFd);
+    reportFd = -1;
+
+    result->status = (WIFEXITED(status)) ? WEXITSTATUS(status) : KREG_ERR_SNAP_WRITE;
+    result->forkUs = lastForkUs;
+
+    return true;
+}
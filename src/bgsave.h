@@ -0,0 +1,54 @@
+#ifndef _BGSAVE_H_
+#define _BGSAVE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Return values of this module */
+#define BGSAVE_OK           0u
+#define BGSAVE_ERR_BUSY     1u
+#define BGSAVE_ERR_FORK     2u
+
+/**
+ * result of a finished background save
+ */
+typedef struct BGSAVE_Result_TAG
+{
+    uint8_t status;         /**< KREG_OK or the error of KREG_WriteSnapshot() */
+    uint64_t forkUs;        /**< time the parent was blocked in fork() */
+    uint64_t saveUs;        /**< time the child spent writing the snapshot */
+    uint64_t cowBytes;      /**< memory copied on write while the child was running */
+} BGSAVE_Result;
+
+/*
+ * BGSAVE_Start() and BGSAVE_Poll() must not be called concurrently,
+ * BGSAVE_InProgress() can be called from any thread.
+ */
+
+/**
+ * Starts writing the snapshot of the registry in a child process,
+ * the registry is seen by the child as it was at the time of the fork
+ *
+ * return values:
+ *  BGSAVE_OK
+ *  BGSAVE_ERR_BUSY (a background save is already running)
+ *  BGSAVE_ERR_FORK
+ */
+uint8_t BGSAVE_Start( const char* fileName );
+
+/**
+ * return values:
+ *  true if a background save is running
+ */
+_Bool BGSAVE_InProgress( void );
+
+/**
+ * Checks (without blocking) whether the background save has finished
+ *
+ * return values:
+ *  true if the save has finished, the result is filled
+ *  false if it is still running (or not started)
+ */
+_Bool BGSAVE_Poll( BGSAVE_Result* result );
+
+#endif /* _BGSAVE_H_ */
@@ -0,0 +1,306 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "epoch.h"
+
+/**************************************************************/
+/* ------------------- symbolic constants ------------------- */
+/**************************************************************/
+
+/* announced epoch of a thread outside of a critical section */
+#define EPOCH_QUIESCENT     0u
+
+/* a retired object can be released when the global epoch is ahead by this much */
+#define EPOCH_GRACE         2u
+
+/**************************************************************/
+/* ------------------- type declarations -------------------- */
+/**************************************************************/
+
+/**
+ * announcement of a reader thread, one cache line each,
+ * so readers never write the same line
+ */
+typedef struct EpochRecord_TAG
+{
+    uint64_t epoch;         /**< epoch seen at the enter (EPOCH_QUIESCENT: outside) */
+    uint32_t inUse;         /**< the record belongs to a thread */
+} __attribute__((aligned(64))) EpochRecord;
+
+/**
+ * retired object waiting for the readers
+ */
+typedef struct Retired_TAG
+{
+    struct Retired_TAG* next;
+    void* object;
+    EPOCH_ReleaseFunc release;
+    uint64_t epoch;         /**< global epoch at the time of the retire */
+} Retired;
+
+/**************************************************************/
+/* ------------------- module local variables --------------- */
+/**************************************************************/
+
+static uint64_t globalEpoch = 1;
+
+static EpochRecord records[EPOCH_MAX_THREADS];
+static uint32_t nrOfRecords = 0;                /**< records ever claimed (high water mark) */
+
+/* record of the calling thread, it is given back when the thread exits */
+static __thread EpochRecord* ownRecord = NULL;
+static pthread_once_t recordKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t recordKey;
+
+/* retired objects, the oldest last; writers are serialized by the lock */
+static pthread_mutex_t retireLock = PTHREAD_MUTEX_INITIALIZER;
+static Retired* retiredObjects = NULL;
+
+/**************************************************************/
+/* ------------------- function prototypes ------------------ */
+/**************************************************************/
+
+static void releaseRecord( void* record );
+static void createRecordKey( void );
+static EpochRecord* claimRecord( void );
+static _Bool tryAdvance( void );
+static Retired* collectReleasable( void );
+static void releaseAll( Retired* list );
+
+/**************************************************************/
+/* ------------------- local functions ---------------------- */
+/**************************************************************/
+
+/**
+ * @brief Gives the record of an exiting thread back
+ *
+ * @param[in]  record
+ * @return     none
+ */
+static void releaseRecord( void* record )
+{
+    EpochRecord* epochRecord = record;
+
+    __atomic_store_n(&epochRecord->epoch, EPOCH_QUIESCENT, __ATOMIC_RELEASE);
+    __atomic_store_n(&epochRecord->inUse, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Creates the thread specific key which releases the records
+ *
+ * @return     none
+ */
+static void createRecordKey( void )
+{
+    pthread_key_create(&recordKey, releaseRecord);
+}
+
+/**
+ * @brief Claims a free record for the calling thread
+ *
+ * If every record is in use, the thread waits till an other thread exits.
+ *
+ * @return     the record of the thread
+ */
+static EpochRecord* claimRecord( void )
+{
+    pthread_once(&recordKeyOnce, createRecordKey);
+
+    for (;;)
+    {
+        for (uint32_t i = 0; i < EPOCH_MAX_THREADS; i++)
+        {
+            uint32_t unused = 0;
+
+            if (__atomic_compare_exchange_n(&records[i].inUse, &unused, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            {
+                uint32_t count = __atomic_load_n(&nrOfRecords, __ATOMIC_RELAXED);
+
+                /* the reclaimer scans the records below the high water mark */
+                while ((count <= i)
+                    && !__atomic_compare_exchange_n(&nrOfRecords, &count, i + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+                {
+                }
+
+                pthread_setspecific(recordKey, &records[i]);
+                return &records[i];
+            }
+        }
+        sched_yield();
+    }
+}
+
+/**
+ * @brief Advances the global epoch if every reader has seen the current one
+ *
+ * The caller must hold the retire lock.
+ *
+ * @return     true if the epoch has been advanced
+ */
+static _Bool tryAdvance( void )
+{
+    uint64_t epoch = __atomic_load_n(&globalEpoch, __ATOMIC_SEQ_CST);
+    uint32_t count = __atomic_load_n(&nrOfRecords, __ATOMIC_ACQUIRE);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint64_t seen = __atomic_load_n(&records[i].epoch, __ATOMIC_SEQ_CST);
+
+        if ((seen != EPOCH_QUIESCENT) && (seen != epoch))
+        {
+            return false;
+        }
+    }
+
+    __atomic_store_n(&globalEpoch, epoch + 1, __ATOMIC_SEQ_CST);
+
+    return true;
+}
+
+/**
+ * @brief Unlinks the retired objects no reader can hold any more
+ *
+ * An object retired in epoch E may be seen by readers which entered in
+ * E (or earlier), every one of them has left when the epoch reaches
+ * E + EPOCH_GRACE. The caller must hold the retire lock.
+ *
+ * @return     list of the releasable objects
+ */
+static Retired* collectReleasable( void )
+{
+    uint64_t epoch = __atomic_load_n(&globalEpoch, __ATOMIC_SEQ_CST);
+    Retired** link = &retiredObjects;
+
+    /* the list is ordered by epoch, so the releasable objects are at its end */
+    while ((*link != NULL) && ((*link)->epoch + EPOCH_GRACE > epoch))
+    {
+        link = &(*link)->next;
+    }
+
+    Retired* releasable = *link;
+
+    *link = NULL;
+
+    return releasable;
+}
+
+/**
+ * @brief Releases a list of retired objects
+ *
+ * @param[in]  list
+ * @return     none
+ */
+static void releaseAll( Retired* list )
+{
+    while (list != NULL)
+    {
+        Retired* next = list->next;
+
+        list->release(list->object);
+        free(list);
+        list = next;
+    }
+}
+
+/**************************************************************/
+/* ------------------- module interfaces -------------------- */
+/**************************************************************/
+
+/**
+ * @brief Enters a read-side critical section
+ *
+ * The thread announces the current epoch. The announcement is ordered
+ * before every load of the critical section, so a writer either sees it
+ * or the reader sees the state after the unlink.
+ *
+ * @return     none
+ */
+void EPOCH_Enter( void )
+{
+    if (ownRecord == NULL)
+    {
+        ownRecord = claimRecord();
+    }
+
+    __atomic_store_n(&ownRecord->epoch, __atomic_load_n(&globalEpoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Leaves the read-side critical section
+ *
+ * @return     none
+ */
+void EPOCH_Exit( void )
+{
+    __atomic_store_n(&ownRecord->epoch, EPOCH_QUIESCENT, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Retires an object
+ *
+ * The object is queued with the current epoch, then the epoch is advanced
+ * if possible and the objects which no reader can hold are released.
+ * If the queue entry can't be allocated, the caller waits for the readers
+ * and the object is released at once.
+ *
+ * @param[in]  object object which is not reachable by new readers
+ * @param[in]  release function releasing the object
+ * @return     none
+ */
+void EPOCH_Retire( void* object, EPOCH_ReleaseFunc release )
+{
+    Retired* retired = malloc(sizeof(Retired));
+    Retired* releasable;
+
+    pthread_mutex_lock(&retireLock);
+
+    if (retired != NULL)
+    {
+        retired->object = object;
+        retired->release = release;
+        retired->epoch = __atomic_load_n(&globalEpoch, __ATOMIC_SEQ_CST);
+        retired->next = retiredObjects;
+        retiredObjects = retired;
+
+        tryAdvance();
+    }
+    else
+    {
+        uint64_t target = __atomic_load_n(&globalEpoch, __ATOMIC_SEQ_CST) + EPOCH_GRACE;
+
+        /* readers never wait for writers, so they leave their critical sections */
+        while (__atomic_load_n(&globalEpoch, __ATOMIC_SEQ_CST) < target)
+        {
+            if (!tryAdvance())
+            {
+                sched_yield();
+            }
+        }
+        release(object);
+    }
+
+    releasable = collectReleasable();
+
+    pthread_mutex_unlock(&retireLock);
+
+    releaseAll(releasable);
+}
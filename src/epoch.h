@@ -0,0 +1,36 @@
+#ifndef _EPOCH_H_
+#define _EPOCH_H_
+
+/** maximum number of threads inside a read-side critical section at the same time */
+#define EPOCH_MAX_THREADS   256u
+
+/**
+ * function releasing a retired object
+ */
+typedef void (*EPOCH_ReleaseFunc)( void* object );
+
+/*
+ * Epoch based reclamation: readers announce the global epoch when they
+ * enter a read-side critical section and they never block. An object
+ * unlinked by a writer is retired, it is released only when every reader
+ * which could still see it has left its critical section.
+ */
+
+/**
+ * Enters a read-side critical section (not reentrant), the objects seen
+ * inside it are not released until EPOCH_Exit()
+ */
+void EPOCH_Enter( void );
+
+/**
+ * Leaves the read-side critical section of the calling thread
+ */
+void EPOCH_Exit( void );
+
+/**
+ * Releases an object (which can't be reached by new readers any more)
+ * when no reader can hold it, may release earlier retired objects
+ */
+void EPOCH_Retire( void* object, EPOCH_ReleaseFunc release );
+
+#endif /* _EPOCH_H_ */
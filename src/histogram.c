@@ -0,0 +1,307 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "histogram.h"
+
+/**************************************************************/
+/* ------------------- symbolic constants ------------------- */
+/**************************************************************/
+
+/* number of buckets of a power of two range above the exact buckets */
+#define HIST_HALF_BUCKETS       (HIST_SUB_BUCKETS / 2u)
+
+/**************************************************************/
+/* ------------------- function prototypes ------------------ */
+/**************************************************************/
+
+static uint32_t countIndex( uint64_t value );
+static uint64_t lowestEquivalent( uint32_t idx );
+static uint64_t highestEquivalent( uint32_t idx );
+
+/**************************************************************/
+/* ------------------- local functions ---------------------- */
+/**************************************************************/
+
+/**
+ * @brief Returns the bucket of a value
+ *
+ * Above the exact buckets, the value is shifted right till it has
+ * HIST_SUB_BUCKET_BITS bits, the shift selects the power of two range
+ * and the remaining bits the bucket within it.
+ *
+ * @param[in]  value
+ * @return     index of the count
+ */
+static uint32_t countIndex( uint64_t value )
+{
+    if (value < HIST_SUB_BUCKETS)
+    {
+        return (uint32_t) value;
+    }
+
+    uint32_t shift = (63u - (uint32_t) __builtin_clzll(value)) - (HIST_SUB_BUCKET_BITS - 1u);
+    uint32_t idx = HIST_SUB_BUCKETS + (shift - 1u) * HIST_HALF_BUCKETS + (uint32_t)(value >> shift) - HIST_HALF_BUCKETS;
+
+    return (idx < HIST_NR_OF_COUNTS) ? idx : HIST_NR_OF_COUNTS - 1u;
+}
+
+/**
+ * @brief Returns the smallest value counted in a bucket
+ *
+ * @param[in]  idx index of the count
+ * @return     value
+ */
+static uint64_t lowestEquivalent( uint32_t idx )
+{
+    if (idx < HIST_SUB_BUCKETS)
+    {
+        return idx;
+    }
+
+    uint32_t shift = (idx - HIST_SUB_BUCKETS) / HIST_HALF_BUCKETS + 1u;
+    uint64_t sub = (idx - HIST_SUB_BUCKETS) % HIST_HALF_BUCKETS + HIST_HALF_BUCKETS;
+
+    return sub << shift;
+}
+
+/**
+ * @brief Returns the largest value counted in a bucket
+ *
+ * @param[in]  idx index of the count
+ * @return     value
+ */
+static uint64_t highestEquivalent( uint32_t idx )
+{
+    if (idx < HIST_SUB_BUCKETS)
+    {
+        return idx;
+    }
+
+    uint32_t shift = (idx - HIST_SUB_BUCKETS) / HIST_HALF_BUCKETS + 1u;
+    uint64_t sub = (idx - HIST_SUB_BUCKETS) % HIST_HALF_BUCKETS + HIST_HALF_BUCKETS;
+
+    return ((sub + 1u) << shift) - 1u;
+}
+
+/**************************************************************/
+/* ------------------- module interfaces -------------------- */
+/**************************************************************/
+
+/**
+ * @brief Empties the histogram
+ *
+ * @param[in]  hist
+ * @return     none
+ */
+void HIST_Reset( HIST_Histogram* hist )
+{
+    memset(hist, 0, sizeof(*hist));
+    hist->min = UINT64_MAX;
+}
+
+/**
+ * @brief Counts a value
+ *
+ * Only the recording thread writes the histogram, so a field is updated
+ * by a plain load and an atomic store (no read-modify-write), other
+ * threads can merge it meanwhile.
+ *
+ * @param[in]  hist
+ * @param[in]  value
+ * @return     none
+ */
+void HIST_Record( HIST_Histogram* hist, uint64_t value )
+{
+    HIST_RecordCount(hist, value, 1u);
+}
+
+/**
+ * @brief Counts a value many times at once
+ *
+ * @param[in]  hist
+ * @param[in]  value
+ * @param[in]  count
+ * @return     none
+ */
+void HIST_RecordCount( HIST_Histogram* hist, uint64_t value, uint64_t count )
+{
+    uint32_t idx = countIndex(value);
+
+    __atomic_store_n(&hist->counts[idx], hist->counts[idx] + count, __ATOMIC_RELAXED);
+    __atomic_store_n(&hist->totalCount, hist->totalCount + count, __ATOMIC_RELAXED);
+
+    if (value < hist->min)
+    {
+        __atomic_store_n(&hist->min, value, __ATOMIC_RELAXED);
+    }
+    if (value > hist->max)
+    {
+        __atomic_store_n(&hist->max, value, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Adds the counts of a histogram to an other one
+ *
+ * @param[in]  dst
+ * @param[in]  src
+ * @return     none
+ */
+void HIST_Merge( HIST_Histogram* dst, const HIST_Histogram* src )
+{
+    uint64_t totalCount = 0;
+    uint64_t min = __atomic_load_n(&src->min, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+
+    /* the total is summed from the counts, so it matches them while src is recorded */
+    for (uint32_t i = 0; i < HIST_NR_OF_COUNTS; i++)
+    {
+        uint64_t count = __atomic_load_n(&src->counts[i], __ATOMIC_RELAXED);
+
+        dst->counts[i] += count;
+        totalCount += count;
+    }
+
+    dst->totalCount += totalCount;
+
+    if (min < dst->min)
+    {
+        dst->min = min;
+    }
+    if (max > dst->max)
+    {
+        dst->max = max;
+    }
+}
+
+/**
+ * @brief Returns the value at a percentile
+ *
+ * The result is the largest value of the bucket where the percentile
+ * falls, but never more than the exact maximum.
+ *
+ * @param[in]  hist
+ * @param[in]  percentile 0.0 - 100.0
+ * @return     value
+ */
+uint64_t HIST_ValueAtPercentile( const HIST_Histogram* hist, double percentile )
+{
+    uint64_t target;
+    uint64_t seen = 0;
+
+    if (hist->totalCount == 0)
+    {
+        return 0;
+    }
+
+    target = (uint64_t) ceil((percentile / 100.0) * (double) hist->totalCount);
+    if (target == 0)
+    {
+        target = 1;
+    }
+
+    for (uint32_t i = 0; i < HIST_NR_OF_COUNTS; i++)
+    {
+        seen += hist->counts[i];
+
+        if (seen >= target)
+        {
+            uint64_t value = highestEquivalent(i);
+
+            return (value < hist->max) ? value : hist->max;
+        }
+    }
+
+    return hist->max;
+}
+
+/**
+ * @brief Writes the percentile distribution in the .hgrm format
+ *
+ * The percentile levels get denser towards 100%: HIST_TICKS_PER_HALF
+ * levels are written each time the remaining distance halves. The last
+ * line is the maximum. Mean and deviation are calculated from the middle
+ * of the buckets.
+ *
+ * @param[in]  hist
+ * @param[in]  file
+ * @param[in]  scale divisor of the written values
+ * @return     none
+ */
+void HIST_WritePercentiles( const HIST_Histogram* hist, FILE* file, double scale )
+{
+    double level = 0.0;
+    double mean = 0.0;
+    double variance = 0.0;
+    uint64_t seen = 0;
+
+    fprintf(file, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+
+    for (uint32_t i = 0; (i < HIST_NR_OF_COUNTS) && (seen < hist->totalCount); i++)
+    {
+        uint64_t value = highestEquivalent(i);
+
+        if (hist->counts[i] == 0)
+        {
+            continue;
+        }
+
+        seen += hist->counts[i];
+        if (value > hist->max)
+        {
+            value = hist->max;
+        }
+
+        /* every level reached in this bucket is written with its value */
+        while ((seen < hist->totalCount) && (100.0 * (double) seen >= level * (double) hist->totalCount))
+        {
+            double halfDistance = pow(2.0, floor(log2(100.0 / (100.0 - level))) + 1.0);
+
+            fprintf(file, "%12.3f %1.12f %10llu %14.2f\n",
+                    (double) value / scale, level / 100.0, (unsigned long long) seen, 100.0 / (100.0 - level));
+            level += 100.0 / (halfDistance * HIST_TICKS_PER_HALF);
+        }
+    }
+
+    if (hist->totalCount > 0)
+    {
+        fprintf(file, "%12.3f %1.12f %10llu\n",
+                (double) hist->max / scale, 1.0, (unsigned long long) hist->totalCount);
+
+        for (uint32_t i = 0; i < HIST_NR_OF_COUNTS; i++)
+        {
+            mean += (double) hist->counts[i] * (double)(lowestEquivalent(i) + highestEquivalent(i)) / 2.0;
+        }
+        mean /= (double) hist->totalCount;
+
+        for (uint32_t i = 0; i < HIST_NR_OF_COUNTS; i++)
+        {
+            double delta = (double)(lowestEquivalent(i) + highestEquivalent(i)) / 2.0 - mean;
+
+            variance += (double) hist->counts[i] * delta * delta;
+        }
+        variance /= (double) hist->totalCount;
+    }
+
+    fprintf(file, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", mean / scale, sqrt(variance) / scale);
+    fprintf(file, "#[Max     = %12.3f, Total count    = %12llu]\n",
+            (double) hist->max / scale, (unsigned long long) hist->totalCount);
+    fprintf(file, "#[Buckets = %12u, SubBuckets     = %12u]\n",
+            HIST_MAX_BITS - HIST_SUB_BUCKET_BITS + 1u, HIST_SUB_BUCKETS);
+}
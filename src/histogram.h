@@ -0,0 +1,75 @@
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Log-linear histogram in the style of HdrHistogram: the values below
+ * HIST_SUB_BUCKETS are counted exactly, every higher power of two range
+ * is split into HIST_SUB_BUCKETS / 2 equal buckets, so a value is known
+ * with 3 significant digits (at most 0.1% error) from 1 to 2^HIST_MAX_BITS.
+ * Recording a value is a few instructions and never allocates.
+ *
+ * A histogram is recorded by one thread, but it can be merged by others.
+ */
+
+/** number of exact buckets (power of two) */
+#define HIST_SUB_BUCKET_BITS    11u
+#define HIST_SUB_BUCKETS        (1u << HIST_SUB_BUCKET_BITS)
+
+/** values up to 2^HIST_MAX_BITS - 1 are counted, larger ones in the last bucket */
+#define HIST_MAX_BITS           42u
+
+#define HIST_NR_OF_COUNTS       (HIST_SUB_BUCKETS + (HIST_MAX_BITS - HIST_SUB_BUCKET_BITS) * (HIST_SUB_BUCKETS / 2u))
+
+/** percentile levels written between two halvings of the remaining distance to 100% */
+#define HIST_TICKS_PER_HALF     5u
+
+/**
+ * Histogram of recorded values (e.g. latencies in nanoseconds)
+ */
+typedef struct HIST_Histogram_TAG
+{
+    uint64_t totalCount;                    /**< number of recorded values */
+    uint64_t min;                           /**< exact minimum (UINT64_MAX if empty) */
+    uint64_t max;                           /**< exact maximum */
+    uint64_t counts[HIST_NR_OF_COUNTS];
+} HIST_Histogram;
+
+/**
+ * Empties the histogram
+ */
+void HIST_Reset( HIST_Histogram* hist );
+
+/**
+ * Counts a value
+ */
+void HIST_Record( HIST_Histogram* hist, uint64_t value );
+
+/**
+ * Counts a value 'count' times
+ */
+void HIST_RecordCount( HIST_Histogram* hist, uint64_t value, uint64_t count );
+
+/**
+ * Adds the counts of 'src' to 'dst' (e.g. the histograms of several threads),
+ * 'src' may be recorded by its own thread meanwhile
+ */
+void HIST_Merge( HIST_Histogram* dst, const HIST_Histogram* src );
+
+/**
+ * return values:
+ *  the value which 'percentile' percent of the recorded values don't
+ *  exceed (within the precision of the histogram), 0 if it is empty
+ */
+uint64_t HIST_ValueAtPercentile( const HIST_Histogram* hist, double percentile );
+
+/**
+ * Writes the percentile distribution in the text format of HdrHistogram
+ * (.hgrm, readable by its plotter), the values are divided by 'scale'
+ * (e.g. 1000.0 to write nanoseconds as microseconds)
+ */
+void HIST_WritePercentiles( const HIST_Histogram* hist, FILE* file, double scale );
+
+#endif /* _HISTOGRAM_H_ */
@@ -1,411 +1,2109 @@
-/*
- * This program is free software: you can redistribute it and/or modify
- * it under the terms of the GNU General Public License as published by
- * the Free Software Foundation, either version 3 of the License, or
- * (at your option) any later version.
- *
- * This program is distributed in the hope that it will be useful,
- * but WITHOUT ANY WARRANTY; without even the implied warranty of
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
- * GNU General Public License for more details.
- *
- * You should have received a copy of the GNU General Public License
- * along with this program.  If not, see <http://www.gnu.org/licenses/>.
- */
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <stdint.h>
-#include <unistd.h>
-#include <ctype.h>
-#include <string.h>
-
-#include "keyregistry.h"
-
-/**************************************************************/
-/* ------------------- type declarations -------------------- */
-/**************************************************************/
-
-/**
- * linked list element type definition to store key-value pairs
- */
-typedef struct KeyValuePair_TAG
-{
-    char* key;
-    char* value;
-    struct KeyValuePair_TAG* next;
-} KeyValuePair;
-
-/**************************************************************/
-/* ------------------- module local variables --------------- */
-/**************************************************************/
-
-static KeyValuePair* keyValuePairs = NULL;
-static KeyValuePair* lastKey = NULL;
-static FILE *regFile = NULL;
-
-/**************************************************************/
-/* ------------------- function prototypes ------------------ */
-/**************************************************************/
-
-static KeyValuePair* searchKey( const char* key );
-static uint8_t readKey( const char* key, char** value );
-static uint8_t storeKey( char* key, char* value );
-static uint8_t parseKeyValue( char** key, char** value, char* line, size_t len, uint16_t* errPos );
-
-/**************************************************************/
-/* ------------------- local functions ---------------------- */
-/**************************************************************/
-
-/**
- * @brief Returns a kvp entry in the list if the given key exists
- *
- * @param[in]  key
- * @return     kvp if it exists in the list
- *             NULL otherwise
- */
-static KeyValuePair* searchKey( const char* key )
-{
-    KeyValuePair* iter = keyValuePairs;
-
-    while (iter)
-    {
-        if (strcmp(key, iter->key) == 0)
-        {
-            return iter;
-        }
-        iter = iter->next;
-    }
-    
-    return NULL;
-}
-
-/**
- * @brief Retrieves the key's value from the list
- *
- * @param[in]  key
- * @param[out] value
- * @return     KREG_OK
- *             KREG_KEY_NOT_FOUND
- */
-static uint8_t readKey( const char* key, char** value )
-{
-    KeyValuePair* keyValue;
-    
-    if ((keyValue = searchKey(key)) == NULL)
-    {
-        return KREG_KEY_NOT_FOUND;
-    }
-    else
-    {
-        *value = keyValue->value;
-    }
-    
-    return KREG_OK;
-}
-
-/**
- * @brief Saves the kvp in the linked list
- *
- * @param[in]  key
- * @param[in]  value
- * @return     KREG_OK
- *             KREG_KEY_EXISTS (only in strict mode)
- */
-static uint8_t storeKey( char* key, char* value )
-{
-    KeyValuePair* newKey;
-    if ((newKey = searchKey(key)) != NULL)
-    {
-#if (KREG_ALLOW_UPDATE == FS_DISABLED)
-        return KREG_KEY_EXISTS;
-#else
-        /* overwrite value */
-        newKey->value = value;
-#endif
-    }
-    else
-    {
-        newKey = (KeyValuePair*) malloc(sizeof(KeyValuePair));
-        
-        if (newKey != NULL)
-        {
-            newKey->key = key;
-            newKey->value = value;
-            newKey->next = NULL;
-            
-            if (keyValuePairs == NULL)
-            {
-                keyValuePairs = newKey;
-            }
-            else
-            {
-                lastKey->next = newKey;
-            }
-            
-            lastKey = newKey;
-        }
-    }
-
-    return KREG_OK;
-}
-
-/**
- * @brief Extracts the key and value from the given string
- *
- * Parses the input string for the key and value.
- * The format can be expressed with two regular expressions
- * (length limitations are not considered):
- *
- *  1. key with empty value : ^\s*([A-Za-z0-9]+)\s?\r?\n?$
- *  2. key with value       : ^\s*([A-Za-z0-9]+)\s(.*)\r?\n?$
- *
- * If the parse was successful, it allocates memory for the key
- * and optionally for the value (if it is not empty)
- *
- * @param[out]  key
- * @param[out]  value
- * @param[in]   line the input string
- * @param[in]   len length of the input string
- * @param[out]  errPos position of the character where the parse failed
- * @return      KREG_OK
- *              KREG_KEY_INVALID
- *              KREG_KEY_EMPTY
- *              KREG_KEY_TOO_LONG
- *              KREG_VAL_TOO_LONG
- */
-static uint8_t parseKeyValue( char** key, char** value, char* line, size_t len, uint16_t* errPos )
-{
-    /* variables to store key and value */
-    char* _key = NULL;
-    char* _value = NULL;
-    
-    /* string iterator */
-    char* linePtr = line;
-
-    /* remove leading spaces */
-    while(*linePtr == ' ')
-    {
-        linePtr++;
-        len--;
-    }
-
-    /* remove trailing (\r)\n chars */
-    for (int i = 0; i < 2; i++)
-    {
-        if ((linePtr[len - 1] == '\n') || (linePtr[len - 1] == '\r'))
-        {
-            linePtr[len - 1] = '\0';
-            len--;
-        }
-    }
-
-    /* start position of the key */
-    char* start = linePtr;
-    uint16_t keyLen = 0;
-
-    /* key parser */
-    while (1)
-    {
-        /* key can contain only digits and letters */
-        if (isalpha(*linePtr) || isdigit(*linePtr))
-        {
-            keyLen++;
-
-            /* if length exceeded the maximum allowed length, return */
-            if (keyLen > KREG_MAX_KEY_LEN)
-            {
-                *errPos = linePtr - line + 1;
-                return KREG_KEY_TOO_LONG;
-            }
-        }
-        /* key is parsed, because the first space is the separator
-         * first character can't be a space, because it was removed before
-         */
-        else if (*linePtr == ' ')
-        {
-            /* allocate memory for the key */
-            _key = malloc(keyLen);
-            memcpy(_key, start, keyLen);
-            *key = _key;
-            
-            /* exit the loop and continiue with value parsing */
-            break;
-        }
-        /* terminal character is reached, this is a key without a value */
-        else if (*linePtr == '\0')
-        {
-            /* if this is the first char, then no key has been provided */
-            if (keyLen == 0)
-            {
-                *errPos = linePtr - line + 1;
-                return KREG_KEY_EMPTY;
-            }
-            
-            _key = malloc(keyLen);
-            memcpy(_key, start, keyLen);
-            *key = _key;
-            
-            return KREG_OK;
-        }
-        /* invalid character found in key */
-        else
-        {
-            *errPos = linePtr - line + 1;
-            return KREG_KEY_INVALID;
-        }
-        
-        /* iterate the position to the next character */
-        linePtr++;
-    }
-
-    /* skip space char that separates key and value */
-    linePtr++;
-
-    uint8_t valLen = len - (linePtr - start);
-    
-    if (valLen > KREG_MAX_VAL_LEN)
-    {
-        *errPos = linePtr - line + KREG_MAX_VAL_LEN + 1;
-        return KREG_VAL_TOO_LONG;
-    }
-    else if (valLen != 0)
-    {
-        _value = malloc(valLen);
-        memcpy(_value, linePtr, valLen);
-        *value = _value;
-    }
-    else /* value length is 0 */
-    {
-        /* do nothing */
-    }
-
-    return KREG_OK;
-}
-
-/**************************************************************/
-/* ------------------- module interfaces -------------------- */
-/**************************************************************/
-
-/**
- * @brief Reads the the registry file
- *
- * Loads the registry file from the storage and builds up the
- * KVP linked list. In case of error, the caller is reported
- * about the position where the parse failed.
- *
- * @param[in]  fileName name of the registry file
- * @param[out] line number where the parse fails
- * @param[out] errPos position of the character in the current line where the parse fails
- * @return     KREG_OK
- *             KREG_ERR_REG_OPEN
- *             KREG_KEY_INVALID
- *             KREG_KEY_TOO_LONG
- *             KREG_VAL_TOO_LONG
- */
-uint8_t KREG_ReadRegistryFile( const char* fileName, uint16_t* lineNr, uint16_t* errPos )
-{
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t nread = 0;
-    uint16_t lineCnt = 0;
-    
-    regFile = fopen(fileName, "r");
-    
-    if (regFile == NULL)
-    {
-        return KREG_ERR_REG_OPEN;
-    }
-    
-    /* read the whole file line by line till EOF */
-    while ((nread = getline(&line, &len, regFile)) != -1)
-    {
-        lineCnt++;
-        /* check empty line */
-        if ((*line != '\r') && (*line != '\n'))
-        {
-            char* key = NULL;
-            char* value = NULL;
-            uint8_t retVal;
-            
-            if ((retVal = parseKeyValue(&key, &value, line, nread, errPos)) != KREG_OK)
-            {        
-                /* release resources first */
-                free(line);
-                fclose(regFile);
-                
-                *lineNr = lineCnt;
-                return retVal;
-            }
-            else
-            {
-                /* no need to re-initialize these, but in case if would be allowed
-                 * for the keyregistry to silently skip erroneous lines, this would be needed
-                 */
-                *lineNr = 0;
-                *errPos = 0;
-                
-                /* key and value is parsed in the line, add it to the list */
-                storeKey(key, value);
-            }
-        }
-        else
-        {
-            /* empty line, skip it */
-        }
-    }
-    
-    /* key and value has been stored, this memory can be released */
-    free(line);
-     
-    return KREG_OK;
-}
-
-/**
- * @brief Retreives a key's value from the registry
- *
- * @param[in]  str input string containing the key
- * @param[out] key storage for parsed key from the input string
- * @param[out] value storage for parsed value from the input string
- * @param[out] character position where the parse failed
- * @return     KREG_OK
- *             KREG_KEY_INVALID
- *             KREG_KEY_EMPTY
- *             KREG_KEY_TOO_LONG
- */
-uint8_t KREG_GetKey( char* str, char** key, char** value, uint16_t* errPos )
-{
-    uint8_t retVal;
-    
-    if ((retVal = parseKeyValue(key, value, str, strlen(str), errPos)) == KREG_OK)
-    {        
-        retVal = readKey(*key, value);
-    }
-    
-    return retVal;
-}
-
-/**
- * @brief Saves a key-value pair in the registry
- *
- * @param[in]  str input string containing the key and value
- * @param[out] key storage for parsed key from the input string
- * @param[out] value storage for parsed value from the input string
- * @param[out] character position where the parse failed
- * @return     KREG_OK
- *             KREG_KEY_INVALID
- *             KREG_KEY_EMPTY
- *             KREG_KEY_TOO_LONG
- *             KREG_VAL_TOO_LONG
- */
-uint8_t KREG_PutKey( char* str, char** key, char** value, uint16_t* errPos )
-{
-    uint8_t retVal;
-    
-    if ((retVal = parseKeyValue(key, value, str, strlen(str), errPos)) == KREG_OK)
-    {        
-        retVal = storeKey(*key, *value);
-    }
-    
-    return retVal;
-}
\ No newline at end of file
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "keyregistry.h"
+#include "arena.h"
+#include "epoch.h"
+
+/**************************************************************/
+/* ------------------- symbolic constants ------------------- */
+/**************************************************************/
+
+/* number of control bytes matched at once (one SSE2 register) */
+#define KREG_GROUP_WIDTH            16u
+
+/* number of shards (power of two), a shard is selected by the top bits of the key hash */
+#define KREG_SHARD_BITS             6u
+#define KREG_NR_OF_SHARDS           (1u << KREG_SHARD_BITS)
+
+/* initial number of slots in the hash table of a shard (power of two, at least one group) */
+#define KREG_INITIAL_TABLE_SIZE     64u
+
+/* the table is doubled when it would become fuller than 7/8 */
+#define KREG_LOAD_FACTOR_NUM        7u
+#define KREG_LOAD_FACTOR_DEN        8u
+
+/* control byte of an unused slot, used slots store the 7 bit fingerprint of the hash */
+#define KREG_CTRL_EMPTY             0x80u
+
+/* size of one key-value slot (one cache line) */
+#define KREG_SLOT_SIZE              64u
+
+/* number of keys of a batch lookup whose probes are interleaved */
+#define KREG_BATCH_SIZE             16u
+
+/* number of parsed keys in one block of a loader thread */
+#define KREG_PARSED_BLOCK_SIZE      4096u
+
+/* a loader thread is started only for at least this many bytes of the registry file */
+#define KREG_MIN_LOAD_CHUNK         (64u * 1024u)
+
+/* binary snapshot format, the header and the table of each shard are page aligned */
+#define KREG_SNAPSHOT_MAGIC         "KVPSNAP"
+#define KREG_SNAPSHOT_VERSION       3u
+#define KREG_SNAPSHOT_BYTE_ORDER    0x01020304u
+#define KREG_SNAPSHOT_HEADER_SIZE   4096u
+#define KREG_SNAPSHOT_ALIGNMENT     4096u
+
+/* seed of the key hash */
+#define KREG_HASH_SEED              0x9E3779B97F4A7C15ull
+
+/**************************************************************/
+/* ------------------- type declarations -------------------- */
+/**************************************************************/
+
+/**
+ * hash table slot type definition to store key-value pairs
+ *
+ * The key and the value are stored inline, one slot fills exactly one cache line.
+ * The key is zero padded to KREG_MAX_KEY_LEN, so it can be compared at once,
+ * the value is zero terminated. The slot is not modified once it is published,
+ * an updated value is published as a new version instead, which overrides the
+ * inline value (readers never see a half written value).
+ */
+typedef struct KeyValuePair_TAG
+{
+    char key[KREG_MAX_KEY_LEN];
+    char value[KREG_MAX_VAL_LEN + 1];
+    uint8_t keyLen;
+    uint8_t valLen;
+    uint8_t reserved[KREG_SLOT_SIZE - KREG_MAX_KEY_LEN - KREG_MAX_VAL_LEN - 3 - sizeof(KREG_Value*)];
+    KREG_Value* version;    /**< latest value if the key has been updated (NULL: the inline value) */
+} __attribute__((aligned(KREG_SLOT_SIZE))) KeyValuePair;
+
+_Static_assert(sizeof(KeyValuePair) == KREG_SLOT_SIZE, "slot must fill one cache line");
+
+/**
+ * "Swiss table" index: the control bytes are stored separately from the slots
+ * in groups of KREG_GROUP_WIDTH, so one vector compare finds every candidate
+ * slot of a group. A probe touches one group of control bytes and (usually)
+ * one slot.
+ *
+ * A published table is read without locks: the control bytes are loaded
+ * atomically and a slot is filled before its control byte is published.
+ * A grown table replaces the old one by a pointer swap, the old one is
+ * released when no reader can see it any more.
+ */
+typedef struct KeyTable_TAG
+{
+    uint8_t* ctrl;          /**< control bytes, one per slot */
+    KeyValuePair* slots;    /**< key-value pairs */
+    uint32_t capacity;      /**< number of slots (power of two) */
+    uint32_t nrOfKeys;      /**< number of used slots */
+    uint64_t seed;          /**< seed of the key hash */
+    ARENA_Arena arena;      /**< memory of the table (one generation) */
+    void* mapping;          /**< memory of the table if it is mapped from a snapshot */
+    size_t mappingSize;
+} KeyTable;
+
+/**
+ * independent part of the registry, it has its own table, memory and lock
+ *
+ * The lock serializes the writers (PUT, load) of the shard, readers don't
+ * take it. The table pointer is in its own cache line, so readers are not
+ * slowed down by the writers taking the lock.
+ */
+typedef struct Shard_TAG
+{
+    pthread_mutex_t lock;
+    KeyTable* table __attribute__((aligned(KREG_SLOT_SIZE)));   /**< current table (NULL: empty) */
+} __attribute__((aligned(KREG_SLOT_SIZE))) Shard;
+
+/**
+ * header of the binary snapshot file
+ *
+ * The header is followed by the table of each shard: the slots and the
+ * control bytes exactly as they are laid out in memory, padded to a page
+ * boundary, so each table is loaded by mapping its part of the file.
+ */
+typedef struct SnapshotHeader_TAG
+{
+    char magic[8];          /**< KREG_SNAPSHOT_MAGIC */
+    uint32_t version;       /**< KREG_SNAPSHOT_VERSION */
+    uint32_t byteOrder;     /**< KREG_SNAPSHOT_BYTE_ORDER as written by the host */
+    uint32_t slotSize;      /**< sizeof(KeyValuePair) */
+    uint32_t groupWidth;    /**< KREG_GROUP_WIDTH */
+    uint32_t nrOfShards;    /**< KREG_NR_OF_SHARDS */
+    uint32_t reserved;
+    uint64_t seed;          /**< seed of the key hash */
+    uint32_t capacity[KREG_NR_OF_SHARDS];   /**< number of slots of each shard */
+    uint32_t nrOfKeys[KREG_NR_OF_SHARDS];   /**< number of used slots of each shard */
+} SnapshotHeader;
+
+_Static_assert(sizeof(SnapshotHeader) <= KREG_SNAPSHOT_HEADER_SIZE, "snapshot header must fit in its page");
+
+/**
+ * state of one key of a batch lookup between the probe stages
+ */
+typedef struct BatchProbe_TAG
+{
+    char paddedKey[KREG_MAX_KEY_LEN];
+    uint64_t hash;
+    const KeyTable* table;  /**< table of the shard of the key (NULL: empty) */
+    uint32_t group;         /**< home group of the key */
+} BatchProbe;
+
+/**
+ * key-value pair parsed by a loader thread, the key is already padded and hashed
+ */
+typedef struct ParsedKey_TAG
+{
+    char key[KREG_MAX_KEY_LEN];
+    uint64_t hash;
+    const char* value;      /**< view into the mapped registry file */
+    uint8_t keyLen;
+    uint8_t valLen;
+} ParsedKey;
+
+/**
+ * block of parsed keys, the blocks of a chunk are linked in file order
+ */
+typedef struct ParsedBlock_TAG
+{
+    struct ParsedBlock_TAG* next;
+    uint32_t count;
+    ParsedKey keys[KREG_PARSED_BLOCK_SIZE];
+} ParsedBlock;
+
+/**
+ * newline aligned part of the registry file, parsed by one loader thread
+ */
+typedef struct LoadChunk_TAG
+{
+    pthread_t thread;
+    const char* start;      /**< first character of the chunk */
+    const char* end;        /**< first character after the chunk */
+    uint64_t seed;          /**< hash seed of the registry */
+    ARENA_Arena arena;      /**< memory of the parsed blocks */
+    ParsedBlock* first;
+    ParsedBlock* last;
+    uint32_t nrOfKeys;      /**< number of parsed keys */
+    uint32_t nrOfLines;     /**< number of lines parsed (including the erroneous one) */
+    uint8_t retVal;         /**< result of the parse */
+    uint16_t errPos;        /**< position of the error in the erroneous line */
+} LoadChunk;
+
+/**************************************************************/
+/* ------------------- module local variables --------------- */
+/**************************************************************/
+
+static Shard shards[KREG_NR_OF_SHARDS] =
+{
+    [0 ... KREG_NR_OF_SHARDS - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER, .table = NULL }
+};
+static uint64_t hashSeed = KREG_HASH_SEED;
+static FILE *regFile = NULL;
+
+/* called for every stored PUT while its shard is still locked */
+static KREG_UpdateHook updateHook = NULL;
+
+/**************************************************************/
+/* ------------------- function prototypes ------------------ */
+/**************************************************************/
+
+static void padKey( const KREG_StrView* key, char* paddedKey );
+static uint64_t hashKey( const char* paddedKey, uint64_t seed );
+static uint16_t matchGroup( const uint8_t* group, uint8_t ctrl );
+static _Bool keyEquals( const char* paddedKey1, const char* paddedKey2 );
+static uint32_t shardIndex( uint64_t hash );
+static uint32_t homeGroup( const KeyTable* table, uint64_t hash );
+static KeyValuePair* searchKey( const KeyTable* table, const char* paddedKey, uint64_t hash );
+static uint32_t findEmptySlot( const KeyTable* table, uint64_t hash );
+static void publishSlot( KeyTable* table, uint32_t idx, uint64_t hash );
+static KeyTable* allocTable( uint32_t capacity, uint64_t seed );
+static void releaseTable( void* table );
+static uint8_t growTable( KeyTable** table );
+static void initTables( KeyTable** tables );
+static void releaseTables( KeyTable** tables );
+static void swapTables( KeyTable** tables );
+static size_t snapshotTableSize( uint32_t capacity );
+static _Bool checkTable( const KeyTable* table );
+static _Bool writeAll( int fd, const void* buf, size_t len );
+static _Bool writeTable( int fd, const KeyTable* table );
+static const char* readValue( const KeyValuePair* slot, uint8_t* valLen );
+static uint8_t storeHashedKey( KeyTable** table, const char* paddedKey, uint8_t keyLen, uint64_t hash, const KREG_StrView* value );
+static uint8_t storeKey( const KREG_StrView* key, const KREG_StrView* value );
+static uint8_t lookupKey( const KREG_StrView* key, KREG_Value* value );
+static uint8_t validateKey( const KREG_StrView* key );
+static uint8_t parseKeyView( KREG_StrView* key, KREG_StrView* value, const char* line, size_t len, uint16_t* errPos );
+static uint8_t parseKeyValue( char** key, char** value, char* line, size_t len, uint16_t* errPos );
+static ParsedKey* newParsedKey( LoadChunk* chunk );
+static void* parseChunk( void* arg );
+
+/**************************************************************/
+/* ------------------- local functions ---------------------- */
+/**************************************************************/
+
+/**
+ * @brief Copies a key into a zero padded buffer
+ *
+ * @param[in]  key parsed key (max KREG_MAX_KEY_LEN characters)
+ * @param[out] paddedKey buffer of KREG_MAX_KEY_LEN bytes
+ * @return     none
+ */
+static void padKey( const KREG_StrView* key, char* paddedKey )
+{
+    memset(paddedKey, 0, KREG_MAX_KEY_LEN);
+    memcpy(paddedKey, key->ptr, key->len);
+}
+
+/**
+ * @brief Calculates the 64 bit hash of a zero padded key
+ *
+ * The key is mixed as two 64 bit words with the finalizer of MurmurHash3.
+ *
+ * @param[in]  paddedKey key padded to KREG_MAX_KEY_LEN bytes
+ * @param[in]  seed hash seed of the table
+ * @return     hash value
+ */
+static uint64_t hashKey( const char* paddedKey, uint64_t seed )
+{
+    uint64_t lo;
+    uint64_t hi;
+
+    memcpy(&lo, paddedKey, sizeof(lo));
+    memcpy(&hi, paddedKey + sizeof(lo), sizeof(hi));
+
+    uint64_t hash = (lo ^ seed) + ((hi ^ (seed >> 32)) * 0x9E3779B97F4A7C15ull);
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+/**
+ * @brief Matches all control bytes of a group against the given value
+ *
+ * The group is loaded as two atomic words, since a writer may publish
+ * a slot of it at the same time. The loads are acquire loads, so the
+ * slot of a matching control byte is seen completely filled.
+ *
+ * @param[in]  group KREG_GROUP_WIDTH control bytes (16 byte aligned)
+ * @param[in]  ctrl control byte to be found
+ * @return     bit mask, bit i is set if the i-th control byte matches
+ */
+static uint16_t matchGroup( const uint8_t* group, uint8_t ctrl )
+{
+    uint64_t lo = __atomic_load_n((const uint64_t*) group, __ATOMIC_ACQUIRE);
+    uint64_t hi = __atomic_load_n((const uint64_t*) group + 1, __ATOMIC_ACQUIRE);
+
+#if defined(__SSE2__)
+    __m128i ctrlBytes = _mm_set_epi64x((long long) hi, (long long) lo);
+
+    return (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrlBytes, _mm_set1_epi8((char) ctrl)));
+#else
+    uint8_t ctrlBytes[KREG_GROUP_WIDTH];
+    uint16_t mask = 0;
+
+    memcpy(ctrlBytes, &lo, sizeof(lo));
+    memcpy(ctrlBytes + sizeof(lo), &hi, sizeof(hi));
+
+    for (uint32_t i = 0; i < KREG_GROUP_WIDTH; i++)
+    {
+        if (ctrlBytes[i] == ctrl)
+        {
+            mask |= (uint16_t)(1u << i);
+        }
+    }
+
+    return mask;
+#endif
+}
+
+/**
+ * @brief Compares two zero padded keys
+ *
+ * @param[in]  paddedKey1
+ * @param[in]  paddedKey2
+ * @return     true if the keys are equal
+ */
+static _Bool keyEquals( const char* paddedKey1, const char* paddedKey2 )
+{
+#if defined(__SSE2__)
+    __m128i key1 = _mm_loadu_si128((const __m128i*) paddedKey1);
+    __m128i key2 = _mm_loadu_si128((const __m128i*) paddedKey2);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(key1, key2)) == 0xFFFF;
+#else
+    return memcmp(paddedKey1, paddedKey2, KREG_MAX_KEY_LEN) == 0;
+#endif
+}
+
+/**
+ * @brief Returns the shard of a key
+ *
+ * The shard is selected by the top bits of the hash, the table of the
+ * shard uses the low bits (fingerprint and home group), so the keys of
+ * a shard are still spread over its whole table.
+ *
+ * @param[in]  hash hash value of the key
+ * @return     index of the shard
+ */
+static uint32_t shardIndex( uint64_t hash )
+{
+    return (uint32_t)(hash >> (64u - KREG_SHARD_BITS));
+}
+
+/**
+ * @brief Returns the group where the probe sequence of a hash starts
+ *
+ * @param[in]  table
+ * @param[in]  hash hash value of the key
+ * @return     index of the group
+ */
+static uint32_t homeGroup( const KeyTable* table, uint64_t hash )
+{
+    return (uint32_t)(hash >> 7) & ((table->capacity / KREG_GROUP_WIDTH) - 1);
+}
+
+/**
+ * @brief Returns the slot of the key in the hash table
+ *
+ * The groups are probed in triangular order, starting from the home group
+ * of the hash. Within a group only the slots with matching fingerprint are
+ * compared. Since keys are never removed, a group with an empty slot
+ * terminates the search.
+ *
+ * @param[in]  table (NULL: empty)
+ * @param[in]  paddedKey key padded to KREG_MAX_KEY_LEN bytes
+ * @param[in]  hash hash value of the key
+ * @return     slot of the key if it exists in the table
+ *             NULL otherwise
+ */
+static KeyValuePair* searchKey( const KeyTable* table, const char* paddedKey, uint64_t hash )
+{
+    if (table == NULL)
+    {
+        return NULL;
+    }
+
+    uint32_t groupMask = (table->capacity / KREG_GROUP_WIDTH) - 1;
+    uint32_t group = homeGroup(table, hash);
+    uint8_t fingerprint = (uint8_t)(hash & 0x7Fu);
+
+    for (uint32_t step = 1; ; step++)
+    {
+        const uint8_t* ctrl = &table->ctrl[group * KREG_GROUP_WIDTH];
+        uint16_t candidates = matchGroup(ctrl, fingerprint);
+
+        while (candidates)
+        {
+            uint32_t idx = group * KREG_GROUP_WIDTH + __builtin_ctz(candidates);
+
+            if (keyEquals(paddedKey, table->slots[idx].key))
+            {
+                return &table->slots[idx];
+            }
+            candidates &= candidates - 1;
+        }
+
+        if (matchGroup(ctrl, KREG_CTRL_EMPTY))
+        {
+            return NULL;
+        }
+
+        group = (group + step) & groupMask;
+    }
+}
+
+/**
+ * @brief Finds the first empty slot on the probe sequence of the hash
+ *
+ * The caller has to make sure that the key is not in the table
+ * and the table has at least one empty slot.
+ *
+ * @param[in]  table
+ * @param[in]  hash hash value of the key to be inserted
+ * @return     index of the empty slot
+ */
+static uint32_t findEmptySlot( const KeyTable* table, uint64_t hash )
+{
+    uint32_t groupMask = (table->capacity / KREG_GROUP_WIDTH) - 1;
+    uint32_t group = homeGroup(table, hash);
+
+    for (uint32_t step = 1; ; step++)
+    {
+        uint16_t empty = matchGroup(&table->ctrl[group * KREG_GROUP_WIDTH], KREG_CTRL_EMPTY);
+
+        if (empty)
+        {
+            return group * KREG_GROUP_WIDTH + __builtin_ctz(empty);
+        }
+
+        group = (group + step) & groupMask;
+    }
+}
+
+/**
+ * @brief Publishes a filled slot by storing its control byte
+ *
+ * The control byte is stored with a release store of its whole word (the
+ * writers of a table are serialized), so a reader which matches it sees
+ * the slot filled.
+ *
+ * @param[in]  table
+ * @param[in]  idx index of the slot
+ * @param[in]  hash hash value of the key in the slot
+ * @return     none
+ */
+static void publishSlot( KeyTable* table, uint32_t idx, uint64_t hash )
+{
+    uint64_t* word = (uint64_t*)(table->ctrl + (idx & ~(uint32_t)(sizeof(uint64_t) - 1)));
+    uint64_t ctrlWord = __atomic_load_n(word, __ATOMIC_RELAXED);
+    uint8_t ctrlBytes[sizeof(uint64_t)];
+
+    memcpy(ctrlBytes, &ctrlWord, sizeof(ctrlWord));
+    ctrlBytes[idx % sizeof(uint64_t)] = (uint8_t)(hash & 0x7Fu);
+    memcpy(&ctrlWord, ctrlBytes, sizeof(ctrlWord));
+
+    __atomic_store_n(word, ctrlWord, __ATOMIC_RELEASE);
+    table->nrOfKeys++;
+}
+
+/**
+ * @brief Allocates an empty hash table in its own arena
+ *
+ * The slots and the control bytes are carved from one block, so the
+ * whole generation of the table can be dropped by releasing the arena.
+ *
+ * @param[in]  capacity number of slots (power of two, at least one group)
+ * @param[in]  seed hash seed of the table
+ * @return     the new table
+ *             NULL if the memory can't be allocated
+ */
+static KeyTable* allocTable( uint32_t capacity, uint64_t seed )
+{
+    size_t slotsSize = (size_t) capacity * sizeof(KeyValuePair);
+    KeyTable* table;
+    uint8_t* block;
+
+    if ((table = malloc(sizeof(KeyTable))) == NULL)
+    {
+        return NULL;
+    }
+
+    /* the block gets a chunk of its own size, small shards don't reserve large chunks */
+    ARENA_Init(&table->arena, 0);
+
+    if ((block = ARENA_Alloc(&table->arena, slotsSize + capacity, KREG_SLOT_SIZE)) == NULL)
+    {
+        free(table);
+        return NULL;
+    }
+
+    table->slots = (KeyValuePair*) block;
+    table->ctrl = block + slotsSize;
+    table->capacity = capacity;
+    table->nrOfKeys = 0;
+    table->seed = seed;
+    table->mapping = NULL;
+    table->mappingSize = 0;
+
+    memset(table->ctrl, KREG_CTRL_EMPTY, capacity);
+
+    return table;
+}
+
+/**
+ * @brief Drops a generation of a hash table with the value versions of its slots
+ *
+ * Called directly for a table which has never been published, otherwise
+ * through the epoch reclamation.
+ *
+ * @param[in]  table
+ * @return     none
+ */
+static void releaseTable( void* table )
+{
+    KeyTable* keyTable = table;
+
+    for (uint32_t i = 0; i < keyTable->capacity; i++)
+    {
+        if (keyTable->ctrl[i] != KREG_CTRL_EMPTY)
+        {
+            free(keyTable->slots[i].version);
+        }
+    }
+
+    ARENA_Release(&keyTable->arena);
+
+    if (keyTable->mapping != NULL)
+    {
+        munmap(keyTable->mapping, keyTable->mappingSize);
+    }
+
+    free(keyTable);
+}
+
+/**
+ * @brief Doubles the size of a hash table (or allocates the first one)
+ *
+ * Existing entries are rehashed into a new generation (updated values are
+ * moved inline), then the new table is published and the old one is
+ * retired, it is released when no reader can see it any more.
+ *
+ * @param[in,out] table published table (NULL: empty), replaced by the new one
+ * @return     KREG_OK
+ *             KREG_ERR_NO_MEM
+ */
+static uint8_t growTable( KeyTable** table )
+{
+    KeyTable* oldTable = *table;
+    KeyTable* newTable;
+    uint32_t capacity = (oldTable == NULL) ? KREG_INITIAL_TABLE_SIZE : (oldTable->capacity * 2);
+
+    if ((newTable = allocTable(capacity, hashSeed)) == NULL)
+    {
+        return KREG_ERR_NO_MEM;
+    }
+
+    for (uint32_t i = 0; (oldTable != NULL) && (i < oldTable->capacity); i++)
+    {
+        if (oldTable->ctrl[i] != KREG_CTRL_EMPTY)
+        {
+            const KeyValuePair* oldSlot = &oldTable->slots[i];
+            uint64_t hash = hashKey(oldSlot->key, newTable->seed);
+            uint32_t idx = findEmptySlot(newTable, hash);
+            KeyValuePair* slot = &newTable->slots[idx];
+
+            *slot = *oldSlot;
+            if (oldSlot->version != NULL)
+            {
+                memcpy(slot->value, oldSlot->version->str, oldSlot->version->len + 1);
+                slot->valLen = oldSlot->version->len;
+                slot->version = NULL;
+            }
+            publishSlot(newTable, idx, hash);
+        }
+    }
+
+    __atomic_store_n(table, newTable, __ATOMIC_RELEASE);
+
+    if (oldTable != NULL)
+    {
+        EPOCH_Retire(oldTable, releaseTable);
+    }
+
+    return KREG_OK;
+}
+
+/**
+ * @brief Initializes an empty generation of the tables of all shards
+ *
+ * @param[out] tables KREG_NR_OF_SHARDS tables
+ * @return     none
+ */
+static void initTables( KeyTable** tables )
+{
+    for (uint32_t i = 0; i < KREG_NR_OF_SHARDS; i++)
+    {
+        tables[i] = NULL;
+    }
+}
+
+/**
+ * @brief Drops a generation of the tables of all shards which has never been published
+ *
+ * @param[in]  tables KREG_NR_OF_SHARDS tables
+ * @return     none
+ */
+static void releaseTables( KeyTable** tables )
+{
+    for (uint32_t i = 0; i < KREG_NR_OF_SHARDS; i++)
+    {
+        if (tables[i] != NULL)
+        {
+            releaseTable(tables[i]);
+        }
+    }
+}
+
+/**
+ * @brief Replaces the tables of all shards with a new generation
+ *
+ * The tables are swapped shard by shard, so readers may see the shards of
+ * both generations during the swap. The old tables are retired.
+ *
+ * @param[in]  tables new generation
+ * @return     none
+ */
+static void swapTables( KeyTable** tables )
+{
+    for (uint32_t i = 0; i < KREG_NR_OF_SHARDS; i++)
+    {
+        KeyTable* oldTable;
+
+        pthread_mutex_lock(&shards[i].lock);
+        oldTable = shards[i].table;
+        __atomic_store_n(&shards[i].table, tables[i], __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&shards[i].lock);
+
+        if (oldTable != NULL)
+        {
+            EPOCH_Retire(oldTable, releaseTable);
+        }
+    }
+}
+
+/**
+ * @brief Returns the size of a table in the snapshot file
+ *
+ * @param[in]  capacity number of slots
+ * @return     size of the slots and the control bytes, padded to KREG_SNAPSHOT_ALIGNMENT
+ */
+static size_t snapshotTableSize( uint32_t capacity )
+{
+    size_t size = (size_t) capacity * (sizeof(KeyValuePair) + 1);
+
+    return (size + KREG_SNAPSHOT_ALIGNMENT - 1) & ~((size_t) KREG_SNAPSHOT_ALIGNMENT - 1);
+}
+
+/**
+ * @brief Checks a table mapped from a snapshot before it is used
+ *
+ * The slots are used as they are, so a corrupt file must not make a
+ * lookup overrun a value, follow a pointer of the file or probe forever:
+ * every control byte is empty or a fingerprint, a used slot has valid
+ * lengths and no value version, the number of used slots is the one of
+ * the header and every group has an empty slot. Every page of the table
+ * is read.
+ *
+ * @param[in]  table
+ * @return     true if the table is valid
+ */
+static _Bool checkTable( const KeyTable* table )
+{
+    uint32_t nrOfKeys = 0;
+
+    for (uint32_t group = 0; group < table->capacity / KREG_GROUP_WIDTH; group++)
+    {
+        _Bool hasEmpty = false;
+
+        for (uint32_t i = group * KREG_GROUP_WIDTH; i < (group + 1) * KREG_GROUP_WIDTH; i++)
+        {
+            const KeyValuePair* slot = &table->slots[i];
+
+            if (table->ctrl[i] == KREG_CTRL_EMPTY)
+            {
+                hasEmpty = true;
+                continue;
+            }
+
+            if ((table->ctrl[i] > 0x7Fu)
+             || (slot->keyLen == 0) || (slot->keyLen > KREG_MAX_KEY_LEN)
+             || (slot->valLen > KREG_MAX_VAL_LEN) || (slot->value[slot->valLen] != '\0')
+             || (slot->version != NULL))
+            {
+                return false;
+            }
+            nrOfKeys++;
+        }
+
+        if (!hasEmpty)
+        {
+            return false;
+        }
+    }
+
+    return nrOfKeys == table->nrOfKeys;
+}
+
+/**
+ * @brief Returns the current value of a slot
+ *
+ * @param[in]  slot published slot
+ * @param[out] valLen length of the value
+ * @return     the zero terminated value (valid till the end of the read-side critical section)
+ */
+static const char* readValue( const KeyValuePair* slot, uint8_t* valLen )
+{
+    const KREG_Value* version = __atomic_load_n(&slot->version, __ATOMIC_ACQUIRE);
+
+    if (version != NULL)
+    {
+        *valLen = version->len;
+        return version->str;
+    }
+
+    *valLen = slot->valLen;
+    return slot->value;
+}
+
+/**
+ * @brief Saves the kvp in a hash table
+ *
+ * A new key is copied into an empty slot, which is published when it is
+ * filled. The table is grown before the insertion if the new key would
+ * exceed the maximum load factor. An updated value is published as a new
+ * version of the slot, the previous version is retired.
+ *
+ * @param[in,out] table table of the shard of the key (NULL: empty), replaced if it is grown
+ * @param[in]  paddedKey key padded to KREG_MAX_KEY_LEN bytes
+ * @param[in]  keyLen length of the key
+ * @param[in]  hash hash value of the key
+ * @param[in]  value (may be empty)
+ * @return     KREG_OK
+ *             KREG_KEY_EXISTS (only in strict mode)
+ *             KREG_ERR_NO_MEM
+ */
+static uint8_t storeHashedKey( KeyTable** table, const char* paddedKey, uint8_t keyLen, uint64_t hash, const KREG_StrView* value )
+{
+    KeyValuePair* slot;
+    uint32_t idx;
+
+    if ((slot = searchKey(*table, paddedKey, hash)) != NULL)
+    {
+#if (KREG_ALLOW_UPDATE == FS_DISABLED)
+        return KREG_KEY_EXISTS;
+#else
+        KREG_Value* version;
+        KREG_Value* oldVersion = slot->version;
+
+        if ((version = malloc(sizeof(KREG_Value))) == NULL)
+        {
+            return KREG_ERR_NO_MEM;
+        }
+        memcpy(version->str, value->ptr, value->len);
+        version->str[value->len] = '\0';
+        version->len = value->len;
+
+        /* overwrite value */
+        __atomic_store_n(&slot->version, version, __ATOMIC_RELEASE);
+
+        if (oldVersion != NULL)
+        {
+            EPOCH_Retire(oldVersion, free);
+        }
+        return KREG_OK;
+#endif
+    }
+
+    if ((*table == NULL) || ((*table)->nrOfKeys + 1) * KREG_LOAD_FACTOR_DEN > (*table)->capacity * KREG_LOAD_FACTOR_NUM)
+    {
+        uint8_t retVal;
+
+        if ((retVal = growTable(table)) != KREG_OK)
+        {
+            return retVal;
+        }
+    }
+
+    idx = findEmptySlot(*table, hash);
+    slot = &(*table)->slots[idx];
+    memset(slot, 0, sizeof(KeyValuePair));
+    memcpy(slot->key, paddedKey, KREG_MAX_KEY_LEN);
+    memcpy(slot->value, value->ptr, value->len);
+    slot->keyLen = keyLen;
+    slot->valLen = value->len;
+    publishSlot(*table, idx, hash);
+
+    return KREG_OK;
+}
+
+/**
+ * @brief Saves the kvp in the registry
+ *
+ * Only the writers of the shard of the key are serialized, readers are
+ * never blocked. The update hook is called before the shard is unlocked,
+ * so the updates of a key are reported in the order they are applied.
+ *
+ * @param[in]  key
+ * @param[in]  value (may be empty)
+ * @return     see storeHashedKey()
+ */
+static uint8_t storeKey( const KREG_StrView* key, const KREG_StrView* value )
+{
+    char paddedKey[KREG_MAX_KEY_LEN];
+    uint64_t hash;
+    Shard* shard;
+    uint8_t retVal;
+
+    padKey(key, paddedKey);
+    hash = hashKey(paddedKey, hashSeed);
+    shard = &shards[shardIndex(hash)];
+
+    pthread_mutex_lock(&shard->lock);
+
+    if (((retVal = storeHashedKey(&shard->table, paddedKey, key->len, hash, value)) == KREG_OK) && (updateHook != NULL))
+    {
+        updateHook(key->ptr, key->len, value->ptr, value->len);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return retVal;
+}
+
+/**
+ * @brief Copies the value of a key out of the registry
+ *
+ * No lock is taken, the table and the value can't be released till the
+ * copy is done.
+ *
+ * @param[in]  key valid key
+ * @param[out] value storage for the value of the key
+ * @return     KREG_OK
+ *             KREG_KEY_NOT_FOUND
+ */
+static uint8_t lookupKey( const KREG_StrView* key, KREG_Value* value )
+{
+    char paddedKey[KREG_MAX_KEY_LEN];
+    const KeyValuePair* slot;
+    uint8_t retVal = KREG_OK;
+
+    padKey(key, paddedKey);
+
+    uint64_t hash = hashKey(paddedKey, hashSeed);
+    Shard* shard = &shards[shardIndex(hash)];
+
+    EPOCH_Enter();
+    if ((slot = searchKey(__atomic_load_n(&shard->table, __ATOMIC_ACQUIRE), paddedKey, hash)) == NULL)
+    {
+        retVal = KREG_KEY_NOT_FOUND;
+    }
+    else
+    {
+        const char* str = readValue(slot, &value->len);
+
+        memcpy(value->str, str, value->len + 1);
+    }
+    EPOCH_Exit();
+
+    return retVal;
+}
+
+/**
+ * @brief Validates a key which has not been parsed from a string
+ *
+ * @param[in]  key
+ * @return     KREG_OK
+ *             KREG_KEY_EMPTY
+ *             KREG_KEY_TOO_LONG
+ *             KREG_KEY_INVALID
+ */
+static uint8_t validateKey( const KREG_StrView* key )
+{
+    if (key->len == 0)
+    {
+        return KREG_KEY_EMPTY;
+    }
+    if (key->len > KREG_MAX_KEY_LEN)
+    {
+        return KREG_KEY_TOO_LONG;
+    }
+
+    for (uint8_t i = 0; i < key->len; i++)
+    {
+        if (!isalnum((unsigned char) key->ptr[i]))
+        {
+            return KREG_KEY_INVALID;
+        }
+    }
+
+    return KREG_OK;
+}
+
+/**
+ * @brief Extracts the key and value from the given string without modifying it
+ *
+ * Parses the input string for the key and value.
+ * The format can be expressed with two regular expressions
+ * (length limitations are not considered):
+ *
+ *  1. key with empty value : ^\s*([A-Za-z0-9]+)\s?\r?\n?$
+ *  2. key with value       : ^\s*([A-Za-z0-9]+)\s(.*)\r?\n?$
+ *
+ * No memory is allocated and the input doesn't have to be zero terminated:
+ * if the parse was successful, the key and the value are borrowed views
+ * into the input string (an empty value has zero length).
+ *
+ * @param[out]  key
+ * @param[out]  value
+ * @param[in]   line the input string
+ * @param[in]   len length of the input string
+ * @param[out]  errPos position of the character where the parse failed
+ * @return      KREG_OK
+ *              KREG_KEY_INVALID
+ *              KREG_KEY_EMPTY
+ *              KREG_KEY_TOO_LONG
+ *              KREG_VAL_TOO_LONG
+ */
+static uint8_t parseKeyView( KREG_StrView* key, KREG_StrView* value, const char* line, size_t len, uint16_t* errPos )
+{
+    /* string iterator */
+    const char* linePtr = line;
+    const char* lineEnd = line + len;
+
+    /* remove leading spaces */
+    while ((linePtr < lineEnd) && (*linePtr == ' '))
+    {
+        linePtr++;
+    }
+
+    /* remove trailing (\r)\n chars */
+    for (int i = 0; i < 2; i++)
+    {
+        if ((lineEnd > linePtr) && ((lineEnd[-1] == '\n') || (lineEnd[-1] == '\r')))
+        {
+            lineEnd--;
+        }
+    }
+
+    /* start position of the key */
+    const char* start = linePtr;
+
+    /* key parser, key can contain only digits and letters */
+    while ((linePtr < lineEnd) && isalnum((unsigned char) *linePtr))
+    {
+        /* if length exceeded the maximum allowed length, return */
+        if (linePtr - start == KREG_MAX_KEY_LEN)
+        {
+            *errPos = linePtr - line + 1;
+            return KREG_KEY_TOO_LONG;
+        }
+        linePtr++;
+    }
+
+    key->ptr = start;
+    key->len = (uint8_t)(linePtr - start);
+    value->ptr = lineEnd;
+    value->len = 0;
+
+    /* end of the input is reached, this is a key without a value */
+    if (linePtr == lineEnd)
+    {
+        /* if this is the first char, then no key has been provided */
+        if (key->len == 0)
+        {
+            *errPos = linePtr - line + 1;
+            return KREG_KEY_EMPTY;
+        }
+        
+        return KREG_OK;
+    }
+
+    /* key is parsed only if the first space is the separator
+     * first character can't be a space, because it was removed before
+     */
+    if (*linePtr != ' ')
+    {
+        *errPos = linePtr - line + 1;
+        return KREG_KEY_INVALID;
+    }
+
+    /* skip space char that separates key and value */
+    linePtr++;
+
+    if (lineEnd - linePtr > KREG_MAX_VAL_LEN)
+    {
+        *errPos = linePtr - line + KREG_MAX_VAL_LEN + 1;
+        return KREG_VAL_TOO_LONG;
+    }
+
+    value->ptr = linePtr;
+    value->len = (uint8_t)(lineEnd - linePtr);
+
+    return KREG_OK;
+}
+
+/**
+ * @brief Extracts the key and value from the given string in place
+ *
+ * Same as parseKeyView(), but the separator after the key and the
+ * trailing line ending are overwritten with zeros, so the returned
+ * key and value (if it is not empty) are zero terminated strings
+ * pointing into the input.
+ *
+ * @param[out]  key
+ * @param[out]  value (not modified if the value is empty)
+ * @param[in]   line the input string (zero terminated)
+ * @param[in]   len length of the input string
+ * @param[out]  errPos position of the character where the parse failed
+ * @return      see parseKeyView()
+ */
+static uint8_t parseKeyValue( char** key, char** value, char* line, size_t len, uint16_t* errPos )
+{
+    KREG_StrView keyView;
+    KREG_StrView valView;
+    uint8_t retVal;
+
+    if ((retVal = parseKeyView(&keyView, &valView, line, len, errPos)) == KREG_OK)
+    {
+        line[(keyView.ptr - line) + keyView.len] = '\0';
+        *key = line + (keyView.ptr - line);
+
+        if (valView.len != 0)
+        {
+            line[(valView.ptr - line) + valView.len] = '\0';
+            *value = line + (valView.ptr - line);
+        }
+    }
+
+    return retVal;
+}
+
+/**
+ * @brief Writes the whole buffer to a file
+ *
+ * @param[in]  fd
+ * @param[in]  buf
+ * @param[in]  len
+ * @return     true if every byte has been written
+ */
+static _Bool writeAll( int fd, const void* buf, size_t len )
+{
+    const uint8_t* ptr = buf;
+
+    while (len > 0)
+    {
+        ssize_t nbytes = write(fd, ptr, len);
+
+        if (nbytes < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        ptr += nbytes;
+        len -= nbytes;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Writes the slots and the control bytes of a table to a file
+ *
+ * Updated values are written inline, so the slots of the file don't
+ * refer to any version.
+ *
+ * @param[in]  fd
+ * @param[in]  table (NULL: empty)
+ * @return     true if the table has been written
+ */
+static _Bool writeTable( int fd, const KeyTable* table )
+{
+    KeyValuePair slots[KREG_SNAPSHOT_ALIGNMENT / sizeof(KeyValuePair)];
+    uint32_t count = 0;
+
+    if (table == NULL)
+    {
+        return true;
+    }
+
+    for (uint32_t i = 0; i < table->capacity; i++)
+    {
+        slots[count] = table->slots[i];
+
+        if (table->slots[i].version != NULL)
+        {
+            memcpy(slots[count].value, table->slots[i].version->str, table->slots[i].version->len + 1);
+            slots[count].valLen = table->slots[i].version->len;
+            slots[count].version = NULL;
+        }
+
+        if ((++count == sizeof(slots) / sizeof(slots[0])) || (i + 1 == table->capacity))
+        {
+            if (!writeAll(fd, slots, count * sizeof(KeyValuePair)))
+            {
+                return false;
+            }
+            count = 0;
+        }
+    }
+
+    return writeAll(fd, table->ctrl, table->capacity);
+}
+
+/**
+ * @brief Returns storage for the next parsed key of a chunk
+ *
+ * @param[in]  chunk
+ * @return     storage for the key
+ *             NULL if the memory can't be allocated
+ */
+static ParsedKey* newParsedKey( LoadChunk* chunk )
+{
+    if ((chunk->last == NULL) || (chunk->last->count == KREG_PARSED_BLOCK_SIZE))
+    {
+        ParsedBlock* block = ARENA_Alloc(&chunk->arena, sizeof(ParsedBlock), sizeof(void*));
+
+        if (block == NULL)
+        {
+            return NULL;
+        }
+
+        if (chunk->last == NULL)
+        {
+            chunk->first = block;
+        }
+        else
+        {
+            chunk->last->next = block;
+        }
+        chunk->last = block;
+    }
+
+    chunk->nrOfKeys++;
+
+    return &chunk->last->keys[chunk->last->count++];
+}
+
+/**
+ * @brief Loader thread, parses and hashes the lines of a chunk
+ *
+ * The thread stops at the first erroneous line, the result is reported
+ * in the chunk.
+ *
+ * @param[in]  arg chunk to be parsed
+ * @return     NULL
+ */
+static void* parseChunk( void* arg )
+{
+    LoadChunk* chunk = (LoadChunk*) arg;
+    const char* line = chunk->start;
+
+    while (line < chunk->end)
+    {
+        const char* newLine = memchr(line, '\n', chunk->end - line);
+        const char* lineEnd = (newLine != NULL) ? (newLine + 1) : chunk->end;
+
+        chunk->nrOfLines++;
+
+        /* check empty line */
+        if ((*line != '\r') && (*line != '\n'))
+        {
+            KREG_StrView key;
+            KREG_StrView value;
+            ParsedKey* parsed;
+
+            if ((chunk->retVal = parseKeyView(&key, &value, line, lineEnd - line, &chunk->errPos)) != KREG_OK)
+            {
+                return NULL;
+            }
+
+            if ((parsed = newParsedKey(chunk)) == NULL)
+            {
+                chunk->retVal = KREG_ERR_NO_MEM;
+                chunk->errPos = 0;
+                return NULL;
+            }
+
+            padKey(&key, parsed->key);
+            parsed->hash = hashKey(parsed->key, chunk->seed);
+            parsed->keyLen = key.len;
+            parsed->value = value.ptr;
+            parsed->valLen = value.len;
+        }
+
+        line = lineEnd;
+    }
+
+    return NULL;
+}
+
+/**************************************************************/
+/* ------------------- module interfaces -------------------- */
+/**************************************************************/
+
+/**
+ * @brief Reads the the registry file
+ *
+ * Loads the registry file from the storage and builds up the
+ * KVP hash table. In case of error, the caller is reported
+ * about the position where the parse failed.
+ *
+ * The function can be called again to reload the registry: the file is
+ * loaded into a new generation of the shards which replaces the current
+ * registry only if the whole file could be loaded. The current registry
+ * is served while the file is being loaded.
+ *
+ * @param[in]  fileName name of the registry file
+ * @param[out] line number where the parse fails
+ * @param[out] errPos position of the character in the current line where the parse fails
+ * @return     KREG_OK
+ *             KREG_ERR_REG_OPEN
+ *             KREG_KEY_INVALID
+ *             KREG_KEY_TOO_LONG
+ *             KREG_VAL_TOO_LONG
+ *             KREG_ERR_NO_MEM
+ */
+uint8_t KREG_ReadRegistryFile( const char* fileName, uint32_t* lineNr, uint16_t* errPos )
+{
+    char *line = NULL;
+    size_t len = 0;
+    ssize_t nread = 0;
+    uint32_t lineCnt = 0;
+    
+    regFile = fopen(fileName, "r");
+    
+    if (regFile == NULL)
+    {
+        return KREG_ERR_REG_OPEN;
+    }
+
+    /* the file is loaded into a new generation, the current one is kept until the load succeeds */
+    KeyTable* tables[KREG_NR_OF_SHARDS];
+
+    initTables(tables);
+    
+    /* read the whole file line by line till EOF */
+    while ((nread = getline(&line, &len, regFile)) != -1)
+    {
+        lineCnt++;
+        /* check empty line */
+        if ((*line != '\r') && (*line != '\n'))
+        {
+            KREG_StrView key;
+            KREG_StrView value;
+            char paddedKey[KREG_MAX_KEY_LEN];
+            uint64_t hash;
+            uint8_t retVal;
+            
+            if ((retVal = parseKeyView(&key, &value, line, nread, errPos)) != KREG_OK)
+            {        
+                /* release resources first */
+                free(line);
+                fclose(regFile);
+
+                /* drop the partially loaded generation */
+                releaseTables(tables);
+                
+                *lineNr = lineCnt;
+                return retVal;
+            }
+            else
+            {
+                /* no need to re-initialize these, but in case if would be allowed
+                 * for the keyregistry to silently skip erroneous lines, this would be needed
+                 */
+                *lineNr = 0;
+                *errPos = 0;
+                
+                /* key and value is parsed in the line, add it to the table
+                 * (duplicated keys are ignored in strict mode)
+                 */
+                padKey(&key, paddedKey);
+                hash = hashKey(paddedKey, hashSeed);
+
+                if ((retVal = storeHashedKey(&tables[shardIndex(hash)], paddedKey, key.len, hash, &value)) == KREG_ERR_NO_MEM)
+                {
+                    free(line);
+                    fclose(regFile);
+
+                    releaseTables(tables);
+
+                    *lineNr = lineCnt;
+                    return retVal;
+                }
+            }
+        }
+        else
+        {
+            /* empty line, skip it */
+        }
+    }
+    
+    /* key and value has been stored, this memory can be released */
+    free(line);
+    fclose(regFile);
+
+    /* the previous generation is dropped in one step */
+    swapTables(tables);
+     
+    return KREG_OK;
+}
+
+/**
+ * @brief Reads the registry file with parallel parsing
+ *
+ * The registry file is mapped into memory and split into newline aligned
+ * chunks which are parsed and hashed by separate threads. The parsed keys
+ * are merged into new shard tables sized for all of their keys, in file
+ * order, so duplicated keys are handled as by KREG_ReadRegistryFile().
+ * In case of error, the first erroneous line of the file is reported.
+ *
+ * The current registry is replaced only if the whole file could be loaded.
+ *
+ * @param[in]  fileName name of the registry file
+ * @param[in]  nrOfThreads number of loader threads (0: one per online CPU)
+ * @param[out] line number where the parse fails
+ * @param[out] errPos position of the character in the current line where the parse fails
+ * @return     KREG_OK
+ *             KREG_ERR_REG_OPEN
+ *             KREG_KEY_INVALID
+ *             KREG_KEY_TOO_LONG
+ *             KREG_VAL_TOO_LONG
+ *             KREG_ERR_NO_MEM
+ */
+uint8_t KREG_ReadRegistryFileParallel( const char* fileName, uint32_t nrOfThreads, uint32_t* lineNr, uint16_t* errPos )
+{
+    struct stat fileStat;
+    const char* fileData = NULL;
+    uint8_t retVal = KREG_OK;
+    int fd;
+
+    if ((fd = open(fileName, O_RDONLY)) < 0)
+    {
+        return KREG_ERR_REG_OPEN;
+    }
+
+    if (fstat(fd, &fileStat) < 0)
+    {
+        close(fd);
+        return KREG_ERR_REG_OPEN;
+    }
+
+    size_t fileSize = fileStat.st_size;
+
+    if (fileSize != 0)
+    {
+        if ((fileData = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+        {
+            close(fd);
+            return KREG_ERR_REG_OPEN;
+        }
+        madvise((void*) fileData, fileSize, MADV_SEQUENTIAL | MADV_WILLNEED);
+    }
+
+    /* one thread per CPU by default, but don't start threads for tiny chunks */
+    if (nrOfThreads == 0)
+    {
+        long nrOfCpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        nrOfThreads = (nrOfCpus > 0) ? nrOfCpus : 1;
+    }
+    if (nrOfThreads > fileSize / KREG_MIN_LOAD_CHUNK)
+    {
+        nrOfThreads = (fileSize / KREG_MIN_LOAD_CHUNK) + 1;
+    }
+
+    LoadChunk* chunks = calloc(nrOfThreads, sizeof(LoadChunk));
+
+    if (chunks == NULL)
+    {
+        if (fileData != NULL)
+        {
+            munmap((void*) fileData, fileSize);
+        }
+        close(fd);
+        return KREG_ERR_NO_MEM;
+    }
+
+    /* split the file into chunks, each of them starts at the beginning of a line */
+    for (uint32_t i = 0; i < nrOfThreads; i++)
+    {
+        const char* start = fileData + (fileSize / nrOfThreads) * i;
+        const char* fileEnd = fileData + fileSize;
+
+        if (i == 0)
+        {
+            start = fileData;
+        }
+        else if (start < chunks[i - 1].start)
+        {
+            start = chunks[i - 1].start;
+        }
+        else
+        {
+            const char* newLine = memchr(start - 1, '\n', fileEnd - start + 1);
+
+            start = (newLine != NULL) ? (newLine + 1) : fileEnd;
+        }
+
+        chunks[i].start = start;
+        chunks[i].end = fileEnd;
+        chunks[i].seed = hashSeed;
+        chunks[i].retVal = KREG_OK;
+        ARENA_Init(&chunks[i].arena, ARENA_DEFAULT_CHUNK_SIZE);
+
+        if (i != 0)
+        {
+            chunks[i - 1].end = start;
+        }
+    }
+
+    /* the first chunk is parsed by the calling thread, as well as the chunks whose thread can't be started */
+    for (uint32_t i = 1; i < nrOfThreads; i++)
+    {
+        if (pthread_create(&chunks[i].thread, NULL, parseChunk, &chunks[i]) != 0)
+        {
+            chunks[i].thread = pthread_self();
+            parseChunk(&chunks[i]);
+        }
+    }
+    parseChunk(&chunks[0]);
+
+    uint32_t lineCnt = 0;
+
+    for (uint32_t i = 0; i < nrOfThreads; i++)
+    {
+        if ((i != 0) && !pthread_equal(chunks[i].thread, pthread_self()))
+        {
+            pthread_join(chunks[i].thread, NULL);
+        }
+
+        /* report the first error of the file */
+        if (retVal == KREG_OK)
+        {
+            lineCnt += chunks[i].nrOfLines;
+
+            if (chunks[i].retVal != KREG_OK)
+            {
+                retVal = chunks[i].retVal;
+                *lineNr = lineCnt;
+                *errPos = chunks[i].errPos;
+            }
+        }
+    }
+
+    if (retVal == KREG_OK)
+    {
+        /* merge the parsed keys into a new generation, each shard is sized for its keys */
+        KeyTable* tables[KREG_NR_OF_SHARDS];
+        uint32_t nrOfKeys[KREG_NR_OF_SHARDS] = { 0 };
+
+        for (uint32_t i = 0; i < nrOfThreads; i++)
+        {
+            for (ParsedBlock* block = chunks[i].first; block != NULL; block = block->next)
+            {
+                for (uint32_t j = 0; j < block->count; j++)
+                {
+                    nrOfKeys[shardIndex(block->keys[j].hash)]++;
+                }
+            }
+        }
+
+        initTables(tables);
+
+        for (uint32_t i = 0; (i < KREG_NR_OF_SHARDS) && (retVal == KREG_OK); i++)
+        {
+            uint32_t capacity = KREG_INITIAL_TABLE_SIZE;
+
+            while ((uint64_t) nrOfKeys[i] * KREG_LOAD_FACTOR_DEN > (uint64_t) capacity * KREG_LOAD_FACTOR_NUM)
+            {
+                capacity *= 2;
+            }
+
+            if ((nrOfKeys[i] != 0) && ((tables[i] = allocTable(capacity, hashSeed)) == NULL))
+            {
+                retVal = KREG_ERR_NO_MEM;
+            }
+        }
+
+        for (uint32_t i = 0; (i < nrOfThreads) && (retVal == KREG_OK); i++)
+        {
+            for (ParsedBlock* block = chunks[i].first; block != NULL; block = block->next)
+            {
+                for (uint32_t j = 0; j < block->count; j++)
+                {
+                    ParsedKey* parsed = &block->keys[j];
+                    KREG_StrView value = { parsed->value, parsed->valLen };
+
+                    /* duplicated keys are ignored in strict mode */
+                    storeHashedKey(&tables[shardIndex(parsed->hash)], parsed->key, parsed->keyLen, parsed->hash, &value);
+                }
+            }
+        }
+
+        if (retVal == KREG_OK)
+        {
+            /* the previous generation is dropped in one step */
+            swapTables(tables);
+            *lineNr = 0;
+            *errPos = 0;
+        }
+        else
+        {
+            releaseTables(tables);
+        }
+    }
+
+    /* release resources */
+    for (uint32_t i = 0; i < nrOfThreads; i++)
+    {
+        ARENA_Release(&chunks[i].arena);
+    }
+    free(chunks);
+
+    if (fileData != NULL)
+    {
+        munmap((void*) fileData, fileSize);
+    }
+    close(fd);
+
+    return retVal;
+}
+
+/**
+ * @brief Writes a binary snapshot of the registry
+ *
+ * The snapshot contains a header (with the hash seed and the capacity of
+ * each shard), followed by the slots and the control bytes of the table of
+ * each shard as they are laid out in memory. The file is written under a
+ * temporary name, synced and renamed, so an existing snapshot is replaced
+ * atomically. The writers of a shard wait while it is written, updates
+ * of the other shards and readers can go on.
+ *
+ * @param[in]  fileName name of the snapshot file
+ * @return     KREG_OK
+ *             KREG_ERR_SNAP_WRITE
+ */
+uint8_t KREG_WriteSnapshot( const char* fileName )
+{
+    static const uint8_t padding[KREG_SNAPSHOT_ALIGNMENT] = { 0 };
+    uint8_t header[KREG_SNAPSHOT_HEADER_SIZE] = { 0 };
+    SnapshotHeader* snapHeader = (SnapshotHeader*) header;
+    char* tmpName;
+    _Bool success;
+    int fd;
+
+    if ((tmpName = malloc(strlen(fileName) + sizeof(".tmp"))) == NULL)
+    {
+        return KREG_ERR_SNAP_WRITE;
+    }
+    sprintf(tmpName, "%s.tmp", fileName);
+
+    if ((fd = open(tmpName, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+    {
+        free(tmpName);
+        return KREG_ERR_SNAP_WRITE;
+    }
+
+    memcpy(snapHeader->magic, KREG_SNAPSHOT_MAGIC, sizeof(KREG_SNAPSHOT_MAGIC));
+    snapHeader->version = KREG_SNAPSHOT_VERSION;
+    snapHeader->byteOrder = KREG_SNAPSHOT_BYTE_ORDER;
+    snapHeader->slotSize = sizeof(KeyValuePair);
+    snapHeader->groupWidth = KREG_GROUP_WIDTH;
+    snapHeader->nrOfShards = KREG_NR_OF_SHARDS;
+    snapHeader->seed = hashSeed;
+
+    /* the header is rewritten when the size of every shard is known */
+    success = writeAll(fd, header, sizeof(header));
+
+    for (uint32_t i = 0; (i < KREG_NR_OF_SHARDS) && success; i++)
+    {
+        pthread_mutex_lock(&shards[i].lock);
+
+        const KeyTable* table = shards[i].table;
+        uint32_t capacity = (table != NULL) ? table->capacity : 0;
+
+        snapHeader->capacity[i] = capacity;
+        snapHeader->nrOfKeys[i] = (table != NULL) ? table->nrOfKeys : 0;
+
+        success = writeTable(fd, table)
+               && writeAll(fd, padding, snapshotTableSize(capacity) - (size_t) capacity * (sizeof(KeyValuePair) + 1));
+
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+
+    success = success
+           && (pwrite(fd, header, sizeof(header), 0) == sizeof(header))
+           && (fsync(fd) == 0);
+
+    if ((close(fd) != 0) || !success || (rename(tmpName, fileName) != 0))
+    {
+        unlink(tmpName);
+        free(tmpName);
+        return KREG_ERR_SNAP_WRITE;
+    }
+
+    free(tmpName);
+
+    return KREG_OK;
+}
+
+/**
+ * @brief Loads the registry from a binary snapshot
+ *
+ * The table of each shard is mapped copy-on-write from its part of the
+ * file and used without parsing any record. The mapped slots are checked
+ * once (see checkTable()), which reads the file but copies nothing.
+ * Updates are kept in the private pages of the mappings, the file is
+ * never modified.
+ *
+ * The current registry is replaced only if the snapshot is valid. The
+ * shard of a key depends on the hash seed, so the seed of the snapshot
+ * must be the seed of the registry.
+ *
+ * @param[in]  fileName name of the snapshot file
+ * @return     KREG_OK
+ *             KREG_ERR_REG_OPEN
+ *             KREG_ERR_SNAP_INVALID
+ */
+uint8_t KREG_LoadSnapshot( const char* fileName )
+{
+    SnapshotHeader snapHeader;
+    KeyTable* tables[KREG_NR_OF_SHARDS];
+    struct stat fileStat;
+    size_t offset = KREG_SNAPSHOT_HEADER_SIZE;
+    int fd;
+
+    if ((fd = open(fileName, O_RDONLY)) < 0)
+    {
+        return KREG_ERR_REG_OPEN;
+    }
+
+    if ((fstat(fd, &fileStat) < 0)
+     || (fileStat.st_size < KREG_SNAPSHOT_HEADER_SIZE)
+     || (pread(fd, &snapHeader, sizeof(snapHeader), 0) != sizeof(snapHeader)))
+    {
+        close(fd);
+        return KREG_ERR_SNAP_INVALID;
+    }
+
+    if ((memcmp(snapHeader.magic, KREG_SNAPSHOT_MAGIC, sizeof(KREG_SNAPSHOT_MAGIC)) != 0)
+     || (snapHeader.version != KREG_SNAPSHOT_VERSION)
+     || (snapHeader.byteOrder != KREG_SNAPSHOT_BYTE_ORDER)
+     || (snapHeader.slotSize != sizeof(KeyValuePair))
+     || (snapHeader.groupWidth != KREG_GROUP_WIDTH)
+     || (snapHeader.nrOfShards != KREG_NR_OF_SHARDS)
+     || (snapHeader.seed != hashSeed))
+    {
+        close(fd);
+        return KREG_ERR_SNAP_INVALID;
+    }
+
+    for (uint32_t i = 0; i < KREG_NR_OF_SHARDS; i++)
+    {
+        uint32_t capacity = snapHeader.capacity[i];
+
+        if (((capacity & (capacity - 1)) != 0)
+         || ((capacity != 0) && (capacity < KREG_GROUP_WIDTH))
+         || (snapHeader.nrOfKeys[i] > capacity))
+        {
+            close(fd);
+            return KREG_ERR_SNAP_INVALID;
+        }
+        offset += snapshotTableSize(capacity);
+    }
+
+    if ((size_t) fileStat.st_size != offset)
+    {
+        close(fd);
+        return KREG_ERR_SNAP_INVALID;
+    }
+
+    initTables(tables);
+    offset = KREG_SNAPSHOT_HEADER_SIZE;
+
+    for (uint32_t i = 0; i < KREG_NR_OF_SHARDS; i++)
+    {
+        uint32_t capacity = snapHeader.capacity[i];
+        size_t tableSize = snapshotTableSize(capacity);
+
+        if (capacity != 0)
+        {
+            KeyTable* table = malloc(sizeof(KeyTable));
+            uint8_t* tableData = MAP_FAILED;
+
+            if ((table == NULL)
+             || ((tableData = mmap(NULL, tableSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset)) == MAP_FAILED))
+            {
+                free(table);
+                releaseTables(tables);
+                close(fd);
+                return KREG_ERR_REG_OPEN;
+            }
+
+            *table = (KeyTable){ .ctrl = tableData + (size_t) capacity * sizeof(KeyValuePair),
+                                 .slots = (KeyValuePair*) tableData, .capacity = capacity,
+                                 .nrOfKeys = snapHeader.nrOfKeys[i], .seed = hashSeed,
+                                 .mapping = tableData, .mappingSize = tableSize };
+            ARENA_Init(&table->arena, 0);
+
+            if (!checkTable(table))
+            {
+                munmap(tableData, tableSize);
+                free(table);
+                releaseTables(tables);
+                close(fd);
+                return KREG_ERR_SNAP_INVALID;
+            }
+            tables[i] = table;
+        }
+        offset += tableSize;
+    }
+
+    close(fd);
+
+    swapTables(tables);
+
+    return KREG_OK;
+}
+
+/**
+ * @brief Retreives a key's value from the registry
+ *
+ * The key points into the input string, the value is copied to the
+ * caller's storage while the registry can't release it, so it stays valid
+ * while other threads store keys.
+ *
+ * @param[in]  str input string containing the key
+ * @param[out] key storage for parsed key from the input string
+ * @param[out] value storage for the value of the key
+ * @param[out] character position where the parse failed
+ * @return     KREG_OK
+ *             KREG_KEY_INVALID
+ *             KREG_KEY_EMPTY
+ *             KREG_KEY_TOO_LONG
+ *             KREG_KEY_NOT_FOUND
+ */
+uint8_t KREG_GetKey( char* str, char** key, KREG_Value* value, uint16_t* errPos )
+{
+    char* valStr = NULL;
+    uint8_t retVal;
+    
+    if ((retVal = parseKeyValue(key, &valStr, str, strlen(str), errPos)) == KREG_OK)
+    {        
+        KREG_StrView keyView = { *key, (uint8_t) strlen(*key) };
+
+        retVal = lookupKey(&keyView, value);
+    }
+    
+    return retVal;
+}
+
+/**
+ * @brief Retreives a key's value from the registry without allocating memory
+ *
+ * The input is neither modified nor has to be zero terminated, the key is
+ * returned as a view into the input and the lookup is done from this view.
+ * The value is copied to the caller's storage. No lock is taken, the
+ * lookup is never blocked by a writer.
+ *
+ * @param[in]  str input string containing the key
+ * @param[in]  len length of the input string
+ * @param[out] key view of the parsed key in the input string
+ * @param[out] value storage for the value of the key
+ * @param[out] character position where the parse failed
+ * @return     KREG_OK
+ *             KREG_KEY_INVALID
+ *             KREG_KEY_EMPTY
+ *             KREG_KEY_TOO_LONG
+ *             KREG_KEY_NOT_FOUND
+ */
+uint8_t KREG_GetKeyView( const char* str, size_t len, KREG_StrView* key, KREG_Value* value, uint16_t* errPos )
+{
+    KREG_StrView valView;
+    uint8_t retVal;
+
+    if ((retVal = parseKeyView(key, &valView, str, len, errPos)) == KREG_OK)
+    {
+        retVal = lookupKey(key, value);
+    }
+
+    return retVal;
+}
+
+/**
+ * @brief Prefetches the control bytes of the home group of a key
+ *
+ * A lookup of the key issued a bit later finds its group in the cache,
+ * so the memory latency of several lookups issued back to back overlaps.
+ * An invalid key is ignored.
+ *
+ * @param[in]  key
+ * @return     none
+ */
+void KREG_PrefetchKey( const KREG_StrView* key )
+{
+    char paddedKey[KREG_MAX_KEY_LEN];
+    const KeyTable* table;
+
+    if ((key->len == 0) || (key->len > KREG_MAX_KEY_LEN))
+    {
+        return;
+    }
+
+    padKey(key, paddedKey);
+
+    uint64_t hash = hashKey(paddedKey, hashSeed);
+
+    /* the table can't be released while its size is read */
+    EPOCH_Enter();
+    if ((table = __atomic_load_n(&shards[shardIndex(hash)].table, __ATOMIC_ACQUIRE)) != NULL)
+    {
+        __builtin_prefetch(&table->ctrl[homeGroup(table, hash) * KREG_GROUP_WIDTH]);
+    }
+    EPOCH_Exit();
+}
+
+/**
+ * @brief Looks up many already parsed keys in the registry
+ *
+ * The keys are resolved in batches of KREG_BATCH_SIZE, the probes of a
+ * batch are interleaved in stages, so the cache misses of its keys are
+ * pending at the same time instead of one after the other:
+ *  1. every key is hashed and the control bytes of its home group are prefetched
+ *  2. the fingerprints are matched and the first candidate slot is prefetched
+ *  3. the keys are compared (the rest of the probe sequence is rarely needed)
+ * The tables seen in the first stage can't be released till the last one.
+ *
+ * @param[in]  keys
+ * @param[in]  nrOfKeys
+ * @param[out] values storage for the value of each key
+ * @param[out] results result of each key, see KREG_LookupKey()
+ * @return     number of keys found
+ */
+size_t KREG_LookupKeys( const KREG_StrView* keys, size_t nrOfKeys, KREG_Value* values, uint8_t* results )
+{
+    BatchProbe probes[KREG_BATCH_SIZE];
+    size_t nrOfFound = 0;
+
+    for (size_t first = 0; first < nrOfKeys; first += KREG_BATCH_SIZE)
+    {
+        size_t count = ((nrOfKeys - first) < KREG_BATCH_SIZE) ? (nrOfKeys - first) : KREG_BATCH_SIZE;
+
+        EPOCH_Enter();
+
+        for (size_t i = 0; i < count; i++)
+        {
+            BatchProbe* probe = &probes[i];
+
+            probe->table = NULL;
+            if ((results[first + i] = validateKey(&keys[first + i])) != KREG_OK)
+            {
+                continue;
+            }
+
+            padKey(&keys[first + i], probe->paddedKey);
+            probe->hash = hashKey(probe->paddedKey, hashSeed);
+            probe->table = __atomic_load_n(&shards[shardIndex(probe->hash)].table, __ATOMIC_ACQUIRE);
+
+            if (probe->table != NULL)
+            {
+                probe->group = homeGroup(probe->table, probe->hash);
+                __builtin_prefetch(&probe->table->ctrl[probe->group * KREG_GROUP_WIDTH]);
+            }
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const BatchProbe* probe = &probes[i];
+
+            if (probe->table != NULL)
+            {
+                uint16_t candidates = matchGroup(&probe->table->ctrl[probe->group * KREG_GROUP_WIDTH], (uint8_t)(probe->hash & 0x7Fu));
+
+                if (candidates)
+                {
+                    __builtin_prefetch(&probe->table->slots[probe->group * KREG_GROUP_WIDTH + __builtin_ctz(candidates)]);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const BatchProbe* probe = &probes[i];
+            const KeyValuePair* slot;
+
+            if (results[first + i] != KREG_OK)
+            {
+                continue;
+            }
+
+            if ((slot = searchKey(probe->table, probe->paddedKey, probe->hash)) == NULL)
+            {
+                results[first + i] = KREG_KEY_NOT_FOUND;
+            }
+            else
+            {
+                const char* str = readValue(slot, &values[first + i].len);
+
+                memcpy(values[first + i].str, str, values[first + i].len + 1);
+                nrOfFound++;
+            }
+        }
+
+        EPOCH_Exit();
+    }
+
+    return nrOfFound;
+}
+
+/**
+ * @brief Looks up an already parsed key in the registry
+ *
+ * Used for requests which are not text (e.g. binary frames), the key is
+ * validated as if it was parsed from a string.
+ *
+ * @param[in]  key
+ * @param[out] value storage for the value of the key
+ * @return     KREG_OK
+ *             KREG_KEY_EMPTY
+ *             KREG_KEY_INVALID
+ *             KREG_KEY_TOO_LONG
+ *             KREG_KEY_NOT_FOUND
+ */
+uint8_t KREG_LookupKey( const KREG_StrView* key, KREG_Value* value )
+{
+    uint8_t retVal;
+
+    if ((retVal = validateKey(key)) == KREG_OK)
+    {
+        retVal = lookupKey(key, value);
+    }
+
+    return retVal;
+}
+
+/**
+ * @brief Saves a key-value pair in the registry
+ *
+ * The key and the value are copied into the registry, the returned
+ * pointers point into the input string.
+ *
+ * @param[in]  str input string containing the key and value
+ * @param[out] key storage for parsed key from the input string
+ * @param[out] value storage for parsed value from the input string
+ * @param[out] character position where the parse failed
+ * @return     KREG_OK
+ *             KREG_KEY_INVALID
+ *             KREG_KEY_EMPTY
+ *             KREG_KEY_TOO_LONG
+ *             KREG_VAL_TOO_LONG
+ */
+uint8_t KREG_PutKey( char* str, char** key, char** value, uint16_t* errPos )
+{
+    uint8_t retVal;
+    
+    if ((retVal = parseKeyValue(key, value, str, strlen(str), errPos)) == KREG_OK)
+    {        
+        KREG_StrView keyView = { *key, (uint8_t) strlen(*key) };
+        KREG_StrView valView = { (*value != NULL) ? *value : "", (uint8_t)((*value != NULL) ? strlen(*value) : 0) };
+
+        retVal = storeKey(&keyView, &valView);
+    }
+    
+    return retVal;
+}
+
+/**
+ * @brief Saves an already parsed key-value pair in the registry
+ *
+ * Used to restore pairs from an other source than a client request
+ * (e.g. the write-ahead log), the key and the value are validated
+ * as if they were parsed from a string.
+ *
+ * @param[in]  key
+ * @param[in]  value (may be empty)
+ * @return     KREG_OK
+ *             KREG_KEY_EMPTY
+ *             KREG_KEY_INVALID
+ *             KREG_KEY_TOO_LONG
+ *             KREG_VAL_TOO_LONG
+ *             KREG_KEY_EXISTS (only in strict mode)
+ *             KREG_ERR_NO_MEM
+ */
+uint8_t KREG_StoreKeyValue( const KREG_StrView* key, const KREG_StrView* value )
+{
+    uint8_t retVal;
+
+    if ((retVal = validateKey(key)) != KREG_OK)
+    {
+        return retVal;
+    }
+    if (value->len > KREG_MAX_VAL_LEN)
+    {
+        return KREG_VAL_TOO_LONG;
+    }
+
+    return storeKey(key, value);
+}
+
+/**
+ * @brief Sets the function called for every stored key-value pair
+ *
+ * The hook is called while the shard of the key is locked, so the updates
+ * of a key are reported in the order they are applied (e.g. to log them).
+ * It must not access the registry.
+ *
+ * @param[in]  hook update hook (NULL: none)
+ * @return     none
+ */
+void KREG_SetUpdateHook( KREG_UpdateHook hook )
+{
+    updateHook = hook;
+}
+
+/**
+ * @brief Blocks every update of the registry
+ *
+ * Every shard is locked in index order, so the calling thread waits for
+ * the updates in progress and the registry is consistent until
+ * KREG_Thaw() (e.g. to fork a process with a consistent image). Readers
+ * are not blocked.
+ *
+ * @return     none
+ */
+void KREG_Freeze( void )
+{
+    for (uint32_t i = 0; i < KREG_NR_OF_SHARDS; i++)
+    {
+        pthread_mutex_lock(&shards[i].lock);
+    }
+}
+
+/**
+ * @brief Releases the shards locked by KREG_Freeze()
+ *
+ * @return     none
+ */
+void KREG_Thaw( void )
+{
+    for (uint32_t i = KREG_NR_OF_SHARDS; i > 0; i--)
+    {
+        pthread_mutex_unlock(&shards[i - 1].lock);
+    }
+}
+
+/**
+ * @brief Releases the shards locked by KREG_Freeze() in a forked child
+ *
+ * The locks are owned by a thread of the parent process, so they can't be
+ * unlocked in the child, they are initialized again instead.
+ *
+ * @return     none
+ */
+void KREG_ThawInChild( void )
+{
+    for (uint32_t i = 0; i < KREG_NR_OF_SHARDS; i++)
+    {
+        shards[i].lock = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+    }
+}
@@ -1,69 +1,213 @@
-#ifndef _KEYREGISTRY_H_
-#define _KEYREGISTRY_H_
-
-#include <stdint.h>
-
-#define FS_DISABLED 0u
-#define FS_ENABLED  1u
-
-/**
- * Feature Switch to enable/disable the possibility of 
- * overwriting values of existing keys
- * possible values:
- *  - FS_ENABLED
- *  - FS_DISABLED (compiled with strict=yes make param)
- *
- * If the macro is not predefined in the makefile, the update is ENABLED
- */
-#ifndef FS_ALLOW_UPDATE
-    #define KREG_ALLOW_UPDATE FS_DISABLED
-#else
-    #define KREG_ALLOW_UPDATE FS_ENABLED
-#endif
-
-/** Return values of this module */
-#define KREG_OK             0u
-#define KREG_ERR_REG_OPEN   1u
-#define KREG_KEY_EMPTY      2u
-#define KREG_KEY_INVALID    3u
-#define KREG_KEY_TOO_LONG   4u
-#define KREG_KEY_NOT_FOUND  5u
-#define KREG_VAL_TOO_LONG   6u
-/* ONLY IN STRICT MODE */
-#define KREG_KEY_EXISTS     7u
-
-/* key and value length are resctircted for simplicity */
-#define KREG_MAX_KEY_LEN    16u
-#define KREG_MAX_VAL_LEN    32u
-
-/**
- * return values:
- *  KREG_OK
- *  KREG_ERR_REG_OPEN
- *  KREG_KEY_INVALID
- *  KREG_KEY_TOO_LONG
- *  KREG_VAL_TOO_LONG
- */
-uint8_t KREG_ReadRegistryFile( const char* fileName, uint16_t* lineNr, uint16_t* errPos );
-
-
-/**
- * return velues:
- *  KREG_OK
- *  KREG_KEY_EMPTY
- *  KREG_KEY_INVALID
- *  KREG_KEY_TOO_LONG
- *  KREG_KEY_NOT_FOUND
- */
-uint8_t KREG_GetKey( char* str, char** key, char** value, uint16_t* errPos );
-
-/**
- * return values:
- *  KREG_OK
- *  KREG_KEY_INVALID
- *  KREG_KEY_TOO_LONG
- *  KREG_ERR_KEY_EXISTS
- */
-uint8_t KREG_PutKey( char* message, char** key, char** value, uint16_t* errPos );
-
-#endif /* _KEYREGISTRY_H_ */
\ No newline at end of file
+#ifndef _KEYREGISTRY_H_
+#define _KEYREGISTRY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FS_DISABLED 0u
+#define FS_ENABLED  1u
+
+/**
+ * Feature Switch to enable/disable the possibility of 
+ * overwriting values of existing keys
+ * possible values:
+ *  - FS_ENABLED
+ *  - FS_DISABLED (compiled with strict=yes make param)
+ *
+ * If the macro is not predefined in the makefile, the update is ENABLED
+ */
+#ifndef FS_ALLOW_UPDATE
+    #define KREG_ALLOW_UPDATE FS_DISABLED
+#else
+    #define KREG_ALLOW_UPDATE FS_ENABLED
+#endif
+
+/** Return values of this module */
+#define KREG_OK             0u
+#define KREG_ERR_REG_OPEN   1u
+#define KREG_KEY_EMPTY      2u
+#define KREG_KEY_INVALID    3u
+#define KREG_KEY_TOO_LONG   4u
+#define KREG_KEY_NOT_FOUND  5u
+#define KREG_VAL_TOO_LONG   6u
+/* ONLY IN STRICT MODE */
+#define KREG_KEY_EXISTS     7u
+#define KREG_ERR_NO_MEM     8u
+#define KREG_ERR_SNAP_INVALID   9u
+#define KREG_ERR_SNAP_WRITE     10u
+
+/* key and value length are resctircted for simplicity */
+#define KREG_MAX_KEY_LEN    16u
+#define KREG_MAX_VAL_LEN    32u
+
+/**
+ * Borrowed (pointer, length) view into a string owned by the caller,
+ * it is not zero terminated
+ */
+typedef struct KREG_StrView_TAG
+{
+    const char* ptr;
+    uint8_t len;
+} KREG_StrView;
+
+/**
+ * Value copied out of the registry (zero terminated)
+ */
+typedef struct KREG_Value_TAG
+{
+    char str[KREG_MAX_VAL_LEN + 1];
+    uint8_t len;
+} KREG_Value;
+
+/**
+ * function called for every stored key-value pair (see KREG_SetUpdateHook())
+ */
+typedef void (*KREG_UpdateHook)( const char* key, uint8_t keyLen, const char* value, uint8_t valLen );
+
+/*
+ * The registry is split into shards, each of them has its own lock:
+ * PUTs lock only the shard of the key, GETs don't take any lock (old
+ * tables and values are released when no reader can see them), so
+ * they can be called from any thread. A load or a snapshot locks the
+ * shards one by one.
+ */
+
+/**
+ * Loads (or reloads) the registry, the current registry is replaced
+ * only if the whole file has been loaded
+ *
+ * return values:
+ *  KREG_OK
+ *  KREG_ERR_REG_OPEN
+ *  KREG_KEY_INVALID
+ *  KREG_KEY_TOO_LONG
+ *  KREG_VAL_TOO_LONG
+ *  KREG_ERR_NO_MEM
+ */
+uint8_t KREG_ReadRegistryFile( const char* fileName, uint32_t* lineNr, uint16_t* errPos );
+
+/**
+ * Same as KREG_ReadRegistryFile(), but the file is memory mapped and
+ * parsed by nrOfThreads threads (0: one thread per online CPU)
+ *
+ * return values:
+ *  see KREG_ReadRegistryFile()
+ */
+uint8_t KREG_ReadRegistryFileParallel( const char* fileName, uint32_t nrOfThreads, uint32_t* lineNr, uint16_t* errPos );
+
+/**
+ * Writes the registry into a binary snapshot file (atomically replaced)
+ *
+ * return values:
+ *  KREG_OK
+ *  KREG_ERR_SNAP_WRITE
+ */
+uint8_t KREG_WriteSnapshot( const char* fileName );
+
+/**
+ * Loads the registry from a binary snapshot file by mapping it into memory,
+ * the current registry is replaced only if the snapshot is valid
+ *
+ * return values:
+ *  KREG_OK
+ *  KREG_ERR_REG_OPEN
+ *  KREG_ERR_SNAP_INVALID
+ */
+uint8_t KREG_LoadSnapshot( const char* fileName );
+
+
+/**
+ * Parses the key of the input (the key points into the input) and copies
+ * its value to the caller's storage
+ *
+ * return velues:
+ *  KREG_OK
+ *  KREG_KEY_EMPTY
+ *  KREG_KEY_INVALID
+ *  KREG_KEY_TOO_LONG
+ *  KREG_KEY_NOT_FOUND
+ */
+uint8_t KREG_GetKey( char* str, char** key, KREG_Value* value, uint16_t* errPos );
+
+/**
+ * Zero allocation variant of KREG_GetKey(), the input is not modified
+ * and doesn't have to be zero terminated
+ *
+ * return velues:
+ *  see KREG_GetKey()
+ */
+uint8_t KREG_GetKeyView( const char* str, size_t len, KREG_StrView* key, KREG_Value* value, uint16_t* errPos );
+
+/**
+ * Looks up an already parsed (but not yet validated) key
+ *
+ * return values:
+ *  see KREG_GetKey()
+ */
+uint8_t KREG_LookupKey( const KREG_StrView* key, KREG_Value* value );
+
+/**
+ * Looks up many already parsed keys at once, the memory accesses of the
+ * keys overlap, so it is faster than a lookup of each key (results[i] is
+ * the return value of KREG_LookupKey() for keys[i])
+ *
+ * return values:
+ *  number of keys found
+ */
+size_t KREG_LookupKeys( const KREG_StrView* keys, size_t nrOfKeys, KREG_Value* values, uint8_t* results );
+
+/**
+ * Hints that the key is going to be looked up (or stored) soon, so the
+ * lookups of several keys can be issued back to back
+ */
+void KREG_PrefetchKey( const KREG_StrView* key );
+
+/**
+ * return values:
+ *  KREG_OK
+ *  KREG_KEY_INVALID
+ *  KREG_KEY_TOO_LONG
+ *  KREG_ERR_KEY_EXISTS
+ *  KREG_ERR_NO_MEM
+ */
+uint8_t KREG_PutKey( char* message, char** key, char** value, uint16_t* errPos );
+
+/**
+ * Saves an already parsed (but not yet validated) key-value pair
+ *
+ * return values:
+ *  KREG_OK
+ *  KREG_KEY_EMPTY
+ *  KREG_KEY_INVALID
+ *  KREG_KEY_TOO_LONG
+ *  KREG_VAL_TOO_LONG
+ *  KREG_KEY_EXISTS
+ *  KREG_ERR_NO_MEM
+ */
+uint8_t KREG_StoreKeyValue( const KREG_StrView* key, const KREG_StrView* value );
+
+/**
+ * Sets the function called for every stored key-value pair while the
+ * shard of the key is locked (NULL: none), so the updates of a key are
+ * reported in the order they are applied. It must be set before the
+ * registry is used by other threads and must not access the registry.
+ */
+void KREG_SetUpdateHook( KREG_UpdateHook hook );
+
+/**
+ * Blocks every update (and waits for the ones in progress), so the
+ * registry stays consistent until KREG_Thaw() (e.g. to fork a process)
+ */
+void KREG_Freeze( void );
+
+/**
+ * Releases KREG_Freeze()
+ */
+void KREG_Thaw( void );
+
+/**
+ * Releases KREG_Freeze() in a child forked while the registry was frozen
+ */
+void KREG_ThawInChild( void );
+
+#endif /* _KEYREGISTRY_H_ */
@@ -0,0 +1,473 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmark of the keyregistry module: the registry functions are
+ * called in process at registry sizes from 100 keys up to the given
+ * maximum (powers of 10), every case is reported in ns/op, allocs/op
+ * and cycles/op.
+ *
+ * The allocations are counted by wrapping malloc(), calloc(), realloc()
+ * and mmap() at link time (-Wl,--wrap=...), so only the calls of the
+ * registry modules are counted, not the ones inside the C library.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "keyregistry.h"
+
+/**************************************************************/
+/* ------------------- symbolic constants ------------------- */
+/**************************************************************/
+
+#define DEFAULT_MAX_KEYS    10000000u
+#define DEFAULT_OPS         1000000u
+#define DEFAULT_TMP_DIR     "/tmp"
+#define MIN_KEYS            100u
+
+/* a request holds a key, a separator space and a value */
+#define REQUEST_LEN         (KREG_MAX_KEY_LEN + KREG_MAX_VAL_LEN + 2u)
+
+#define NS_PER_SEC          1000000000ull
+
+/**************************************************************/
+/* ------------------- type declarations -------------------- */
+/**************************************************************/
+
+/**
+ * Request strings of a case, each of them is used once (they are
+ * modified by the parser)
+ */
+typedef char Request[REQUEST_LEN];
+
+/**
+ * Cost of a measured case
+ */
+typedef struct Measurement_TAG
+{
+    uint64_t ns;
+    uint64_t allocs;
+    uint64_t cycles;
+} Measurement;
+
+/**************************************************************/
+/* ------------------- module local variables --------------- */
+/**************************************************************/
+
+static uint32_t maxKeys = DEFAULT_MAX_KEYS;
+static uint32_t nrOfOps = DEFAULT_OPS;
+static const char* tmpDir = DEFAULT_TMP_DIR;
+
+/* allocations of the registry modules */
+static uint64_t nrOfAllocs = 0;
+
+/* state of the random generator */
+static uint64_t rngState = 0x9E3779B97F4A7C15ull;
+
+/**************************************************************/
+/* ------------------- function prototypes ------------------ */
+/**************************************************************/
+
+void* __real_malloc( size_t size );
+void* __real_calloc( size_t nmemb, size_t size );
+void* __real_realloc( void* ptr, size_t size );
+void* __real_mmap( void* addr, size_t len, int prot, int flags, int fd, off_t offset );
+void* __wrap_malloc( size_t size );
+void* __wrap_calloc( size_t nmemb, size_t size );
+void* __wrap_realloc( void* ptr, size_t size );
+void* __wrap_mmap( void* addr, size_t len, int prot, int flags, int fd, off_t offset );
+
+static uint64_t nowNs( void );
+static uint64_t readCycles( void );
+static uint32_t nextRandom( uint32_t bound );
+static void startMeasurement( Measurement* m );
+static void stopMeasurement( Measurement* m );
+static void printResult( uint32_t nrOfKeys, const char* operation, const Measurement* m, uint32_t ops );
+static void writeRegistryFile( const char* fileName, uint32_t nrOfKeys );
+static void benchLoad( uint32_t nrOfKeys );
+static void benchGet( uint32_t nrOfKeys, Request* requests, _Bool hit );
+static void benchPut( uint32_t nrOfKeys, Request* requests, _Bool insert );
+static void processCmdLineOpts( int argc, char** argv );
+
+/**************************************************************/
+/* ------------------- local functions ---------------------- */
+/**************************************************************/
+
+/* allocation counters, the registry modules are linked against these */
+
+void* __wrap_malloc( size_t size )
+{
+    __atomic_fetch_add(&nrOfAllocs, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc( size_t nmemb, size_t size )
+{
+    __atomic_fetch_add(&nrOfAllocs, 1, __ATOMIC_RELAXED);
+    return __real_calloc(nmemb, size);
+}
+
+void* __wrap_realloc( void* ptr, size_t size )
+{
+    __atomic_fetch_add(&nrOfAllocs, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+void* __wrap_mmap( void* addr, size_t len, int prot, int flags, int fd, off_t offset )
+{
+    /* only the anonymous mappings are memory allocations (e.g. arena chunks) */
+    if (flags & MAP_ANONYMOUS)
+    {
+        __atomic_fetch_add(&nrOfAllocs, 1, __ATOMIC_RELAXED);
+    }
+    return __real_mmap(addr, len, prot, flags, fd, offset);
+}
+
+/**
+ * @brief Returns the monotonic time
+ *
+ * @return     nanoseconds
+ */
+static uint64_t nowNs( void )
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * NS_PER_SEC + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * @brief Returns the time stamp counter of the CPU
+ *
+ * @return     reference cycles (0 if there is no time stamp counter)
+ */
+static uint64_t readCycles( void )
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Returns a random number (xorshift64*)
+ *
+ * @param[in]  bound
+ * @return     random number in [0, bound)
+ */
+static uint32_t nextRandom( uint32_t bound )
+{
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+
+    return (uint32_t)((rngState * 0x2545F4914F6CDD1Dull >> 32) % bound);
+}
+
+/**
+ * @brief Starts a measurement
+ *
+ * @param[out] m
+ * @return     none
+ */
+static void startMeasurement( Measurement* m )
+{
+    m->allocs = __atomic_load_n(&nrOfAllocs, __ATOMIC_RELAXED);
+    m->ns = nowNs();
+    m->cycles = readCycles();
+}
+
+/**
+ * @brief Stops a measurement, the costs are stored in it
+ *
+ * @param[in]  m
+ * @return     none
+ */
+static void stopMeasurement( Measurement* m )
+{
+    m->cycles = readCycles() - m->cycles;
+    m->ns = nowNs() - m->ns;
+    m->allocs = __atomic_load_n(&nrOfAllocs, __ATOMIC_RELAXED) - m->allocs;
+}
+
+/**
+ * @brief Prints a line of the result table
+ *
+ * @param[in]  nrOfKeys registry size
+ * @param[in]  operation name of the case
+ * @param[in]  m costs of the case
+ * @param[in]  ops number of operations in the case
+ * @return     none
+ */
+static void printResult( uint32_t nrOfKeys, const char* operation, const Measurement* m, uint32_t ops )
+{
+    fprintf(stdout, "%10u  %-22s %10.1f %11.3f %11.1f\n", nrOfKeys, operation,
+            (double) m->ns / ops, (double) m->allocs / ops, (double) m->cycles / ops);
+    fflush(stdout);
+}
+
+/**
+ * @brief Writes a registry file of keys k0 .. kN-1
+ *
+ * Program is terminated if the file can't be written
+ *
+ * @param[in]  fileName
+ * @param[in]  nrOfKeys
+ * @return     none
+ */
+static void writeRegistryFile( const char* fileName, uint32_t nrOfKeys )
+{
+    FILE* file = fopen(fileName, "w");
+
+    if (file == NULL)
+    {
+        perror(fileName);
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t i = 0; i < nrOfKeys; i++)
+    {
+        fprintf(file, "k%u v%u\n", i, i);
+    }
+
+    if (fclose(file) != 0)
+    {
+        perror(fileName);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Measures the load of a registry file (per line)
+ *
+ * The loaded registry is used by the next cases.
+ *
+ * @param[in]  nrOfKeys
+ * @return     none
+ */
+static void benchLoad( uint32_t nrOfKeys )
+{
+    char fileName[256];
+    Measurement m;
+    uint32_t lineNr = 0;
+    uint16_t errPos = 0;
+    uint8_t retVal;
+
+    snprintf(fileName, sizeof(fileName), "%s/kreg_bench_%d.txt", tmpDir, (int) getpid());
+    writeRegistryFile(fileName, nrOfKeys);
+
+    startMeasurement(&m);
+    retVal = KREG_ReadRegistryFile(fileName, &lineNr, &errPos);
+    stopMeasurement(&m);
+
+    unlink(fileName);
+
+    if (retVal != KREG_OK)
+    {
+        fprintf(stderr, "Registry load failed (%u) in line %u\n", retVal, lineNr);
+        exit(EXIT_FAILURE);
+    }
+
+    printResult(nrOfKeys, "ReadRegistryFile", &m, nrOfKeys);
+}
+
+/**
+ * @brief Measures the lookup of existing or missing keys
+ *
+ * @param[in]  nrOfKeys keys k0 .. kN-1 are in the registry
+ * @param[in]  requests storage of nrOfOps requests
+ * @param[in]  hit the keys exist
+ * @return     none
+ */
+static void benchGet( uint32_t nrOfKeys, Request* requests, _Bool hit )
+{
+    uint8_t expected = hit ? KREG_OK : KREG_KEY_NOT_FOUND;
+    uint32_t nrOfFailures = 0;
+    Measurement m;
+
+    for (uint32_t i = 0; i < nrOfOps; i++)
+    {
+        snprintf(requests[i], REQUEST_LEN, "%c%u", hit ? 'k' : 'm', nextRandom(nrOfKeys));
+    }
+
+    startMeasurement(&m);
+    for (uint32_t i = 0; i < nrOfOps; i++)
+    {
+        char* key = NULL;
+        KREG_Value value;
+        uint16_t errPos = 0;
+
+        nrOfFailures += (KREG_GetKey(requests[i], &key, &value, &errPos) != expected);
+    }
+    stopMeasurement(&m);
+
+    if (nrOfFailures != 0)
+    {
+        fprintf(stderr, "%u unexpected GetKey results\n", nrOfFailures);
+        exit(EXIT_FAILURE);
+    }
+
+    printResult(nrOfKeys, hit ? "GetKey (hit)" : "GetKey (miss)", &m, nrOfOps);
+}
+
+/**
+ * @brief Measures the store of new keys or the update of existing ones
+ *
+ * As many keys are inserted as the registry holds (at most the number of
+ * operations), so the growth of the registry is part of the cost.
+ *
+ * @param[in]  nrOfKeys keys k0 .. kN-1 are in the registry
+ * @param[in]  requests storage of nrOfOps requests
+ * @param[in]  insert new keys are stored instead of updating the existing ones
+ * @return     none
+ */
+static void benchPut( uint32_t nrOfKeys, Request* requests, _Bool insert )
+{
+    uint32_t ops = (insert && (nrOfKeys < nrOfOps)) ? nrOfKeys : nrOfOps;
+    uint32_t nrOfFailures = 0;
+    Measurement m;
+
+    for (uint32_t i = 0; i < ops; i++)
+    {
+        if (insert)
+        {
+            snprintf(requests[i], REQUEST_LEN, "n%u v%u", i, i);
+        }
+        else
+        {
+            snprintf(requests[i], REQUEST_LEN, "k%u w%u", nextRandom(nrOfKeys), i);
+        }
+    }
+
+    startMeasurement(&m);
+    for (uint32_t i = 0; i < ops; i++)
+    {
+        char* key = NULL;
+        char* value = NULL;
+        uint16_t errPos = 0;
+
+        nrOfFailures += (KREG_PutKey(requests[i], &key, &value, &errPos) != KREG_OK);
+    }
+    stopMeasurement(&m);
+
+    if (nrOfFailures != 0)
+    {
+        fprintf(stderr, "%u unexpected PutKey results\n", nrOfFailures);
+        exit(EXIT_FAILURE);
+    }
+
+    printResult(nrOfKeys, insert ? "PutKey (insert)" : "PutKey (overwrite)", &m, ops);
+}
+
+/**
+ * @brief Processes the input parameters of the main() function
+ *
+ * Optional
+ * ---------
+ *  -n keys      : largest registry size (default 10000000)
+ *  -o ops       : operations of a lookup or update case (default 1000000)
+ *  -d dir       : directory of the temporary registry files (default /tmp)
+ *
+ * @param[in] argc nr of arguments
+ * @param[in] argv arg array
+ * @return none
+ */
+static void processCmdLineOpts( int argc, char** argv )
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:o:d:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                maxKeys = (uint32_t) strtoul(optarg, NULL, 0);
+                if (maxKeys < MIN_KEYS)
+                {
+                    fprintf(stderr, "Invalid number of keys %s (min %u)\n", optarg, MIN_KEYS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'o':
+                nrOfOps = (uint32_t) strtoul(optarg, NULL, 0);
+                if (nrOfOps == 0)
+                {
+                    fprintf(stderr, "Invalid number of operations %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'd':
+                tmpDir = optarg;
+                break;
+
+            /* unknown option or missing argument */
+            default:
+                exit(EXIT_FAILURE);
+        }
+    }
+}
+
+int main( int argc, char** argv )
+{
+    Request* requests;
+
+    processCmdLineOpts(argc, argv);
+
+    if ((requests = malloc((size_t) nrOfOps * sizeof(Request))) == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(stdout, "* keyregistry benchmark, %u operations per case, update of keys %s\n",
+            nrOfOps, (KREG_ALLOW_UPDATE == FS_ENABLED) ? "allowed" : "not allowed");
+#ifndef __OPTIMIZE__
+    fprintf(stdout, "* WARNING: built without optimization (e.g. -DCMAKE_BUILD_TYPE=Release)\n");
+#endif
+    fprintf(stdout, "%10s  %-22s %10s %11s %11s\n", "keys", "operation", "ns/op", "allocs/op", "cycles/op");
+
+    for (uint64_t nrOfKeys = MIN_KEYS; nrOfKeys <= maxKeys; nrOfKeys *= 10u)
+    {
+        benchLoad((uint32_t) nrOfKeys);
+        benchGet((uint32_t) nrOfKeys, requests, true);
+        benchGet((uint32_t) nrOfKeys, requests, false);
+
+        if (KREG_ALLOW_UPDATE == FS_ENABLED)
+        {
+            benchPut((uint32_t) nrOfKeys, requests, false);
+        }
+        benchPut((uint32_t) nrOfKeys, requests, true);
+    }
+
+    free(requests);
+
+    exit(EXIT_SUCCESS);
+}
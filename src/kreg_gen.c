@@ -0,0 +1,378 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Generator of synthetic registry files: every line is a key (letters
+ * and digits, at most KREG_MAX_KEY_LEN characters), a space and a value
+ * (at most KREG_MAX_VAL_LEN characters), as the registry parser expects.
+ *
+ * Every key is a function of its index and the seed: an optional shared
+ * prefix, a unique id (the index scrambled and written in base 62) and a
+ * random filler up to the chosen length. So the same parameters always
+ * give the same file and a duplicate is made by regenerating an earlier
+ * key, no key has to be stored.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "keyregistry.h"
+
+/**************************************************************/
+/* ------------------- symbolic constants ------------------- */
+/**************************************************************/
+
+#define DEFAULT_NR_OF_LINES     1000000u
+#define DEFAULT_SEED            1u
+
+#define OUT_BUF_SIZE            (1024u * 1024u)
+
+/* characters of the keys (the unique id is written with these too) */
+#define KEY_CHARS               "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+#define NR_OF_KEY_CHARS         62u
+
+/* the ids are scrambled by this multiplier (relative prime to 62^n) */
+#define ID_MULTIPLIER           2654435761ull
+
+/**************************************************************/
+/* ------------------- type declarations -------------------- */
+/**************************************************************/
+
+/**
+ * Length distribution of keys or values
+ */
+typedef struct LenRange_TAG
+{
+    uint32_t min;
+    uint32_t max;       /**< uniform in [min, max] */
+} LenRange;
+
+/**************************************************************/
+/* ------------------- module local variables --------------- */
+/**************************************************************/
+
+static uint64_t nrOfLines = DEFAULT_NR_OF_LINES;
+static uint64_t seed = DEFAULT_SEED;
+static LenRange keyLen = { 1, KREG_MAX_KEY_LEN };
+static LenRange valLen = { 1, KREG_MAX_VAL_LEN };
+static uint32_t nrOfPrefixes = 0;
+static uint32_t prefixLen = 0;
+static uint32_t dupPercent = 0;
+static _Bool crlf = false;
+static const char* outFileName = NULL;
+
+/* characters of the unique id */
+static uint32_t idLen;
+static uint64_t idSpace;
+
+/**************************************************************/
+/* ------------------- function prototypes ------------------ */
+/**************************************************************/
+
+static uint64_t mix( uint64_t x );
+static uint32_t pickLen( const LenRange* range, uint64_t random );
+static uint32_t makeKey( uint64_t idx, char* key );
+static uint32_t makeValue( uint64_t lineNr, char* value );
+static void parseLenRange( const char* arg, LenRange* range, uint32_t limit, const char* name );
+static void processCmdLineOpts( int argc, char** argv );
+
+/**************************************************************/
+/* ------------------- local functions ---------------------- */
+/**************************************************************/
+
+/**
+ * @brief Returns a hash of a number (the finalizer of splitmix64)
+ *
+ * @param[in]  x
+ * @return     hash
+ */
+static uint64_t mix( uint64_t x )
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Picks a length from a range
+ *
+ * @param[in]  range
+ * @param[in]  random
+ * @return     length
+ */
+static uint32_t pickLen( const LenRange* range, uint64_t random )
+{
+    return range->min + (uint32_t)(random % (range->max - range->min + 1u));
+}
+
+/**
+ * @brief Generates the key of an index
+ *
+ * The same index always gives the same key and different indexes give
+ * different keys (the prefix and the id are never cut).
+ *
+ * @param[in]  idx index of the key
+ * @param[out] key buffer of KREG_MAX_KEY_LEN characters (not terminated)
+ * @return     length of the key
+ */
+static uint32_t makeKey( uint64_t idx, char* key )
+{
+    uint64_t random = mix(seed ^ mix(idx));
+    uint64_t id = (idx * ID_MULTIPLIER) % idSpace;
+    uint32_t len = pickLen(&keyLen, random);
+    uint32_t pos = 0;
+
+    if (nrOfPrefixes != 0)
+    {
+        /* the prefixes are keys of their own index space */
+        uint64_t prefixRandom = mix(~seed ^ (random % nrOfPrefixes));
+
+        for (; pos < prefixLen; pos++)
+        {
+            key[pos] = KEY_CHARS[prefixRandom % NR_OF_KEY_CHARS];
+            prefixRandom = mix(prefixRandom);
+        }
+    }
+
+    for (uint32_t i = 0; i < idLen; i++, pos++)
+    {
+        key[pos] = KEY_CHARS[id % NR_OF_KEY_CHARS];
+        id /= NR_OF_KEY_CHARS;
+    }
+
+    for (random = mix(random); pos < len; pos++)
+    {
+        key[pos] = KEY_CHARS[random % NR_OF_KEY_CHARS];
+        random = mix(random);
+    }
+
+    return pos;
+}
+
+/**
+ * @brief Generates the value of a line
+ *
+ * The value contains letters, digits and spaces, but it doesn't start
+ * or end with a space.
+ *
+ * @param[in]  lineNr
+ * @param[out] value buffer of KREG_MAX_VAL_LEN characters (not terminated)
+ * @return     length of the value
+ */
+static uint32_t makeValue( uint64_t lineNr, char* value )
+{
+    uint64_t random = mix(~seed ^ mix(lineNr));
+    uint32_t len = pickLen(&valLen, random);
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        random = mix(random);
+        value[i] = (((random >> 32) % 8u == 0) && (i > 0) && (i < len - 1u))
+                   ? ' '
+                   : KEY_CHARS[random % NR_OF_KEY_CHARS];
+    }
+
+    return len;
+}
+
+/**
+ * @brief Parses a length distribution: "LEN" or "MIN-MAX"
+ *
+ * Program is terminated if the range is invalid
+ *
+ * @param[in]  arg option argument
+ * @param[out] range
+ * @param[in]  limit largest valid length
+ * @param[in]  name name of the option in the error message
+ * @return     none
+ */
+static void parseLenRange( const char* arg, LenRange* range, uint32_t limit, const char* name )
+{
+    char* end;
+
+    range->min = (uint32_t) strtoul(arg, &end, 10);
+    range->max = (*end == '-') ? (uint32_t) strtoul(end + 1, &end, 10) : range->min;
+
+    if ((*end != '\0') || (range->min == 0) || (range->min > range->max) || (range->max > limit))
+    {
+        fprintf(stderr, "Invalid %s length %s (1 - %u)\n", name, arg, limit);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Processes the input parameters of the main() function
+ *
+ * Optional
+ * ---------
+ *  -n lines       : number of lines (default 1000000)
+ *  -k len|min-max : key length (default 1-16)
+ *  -v len|min-max : value length (default 1-32)
+ *  -p nr:len      : the keys start with one of 'nr' prefixes of 'len' characters
+ *  -d percent     : share of the lines repeating an earlier key (default 0)
+ *  -s seed        : seed of the generator (default 1)
+ *  -r             : lines are terminated by \r\n instead of \n
+ *  -o file        : output file (default standard output)
+ *
+ * @param[in] argc nr of arguments
+ * @param[in] argv arg array
+ * @return none
+ */
+static void processCmdLineOpts( int argc, char** argv )
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:k:v:p:d:s:ro:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                nrOfLines = strtoull(optarg, NULL, 0);
+                break;
+
+            case 'k':
+                parseLenRange(optarg, &keyLen, KREG_MAX_KEY_LEN, "key");
+                break;
+
+            case 'v':
+                parseLenRange(optarg, &valLen, KREG_MAX_VAL_LEN, "value");
+                break;
+
+            case 'p':
+            {
+                char* end;
+
+                nrOfPrefixes = (uint32_t) strtoul(optarg, &end, 10);
+                prefixLen = (*end == ':') ? (uint32_t) strtoul(end + 1, &end, 10) : 0;
+
+                if ((*end != '\0') || (nrOfPrefixes == 0) || (prefixLen == 0) || (prefixLen >= KREG_MAX_KEY_LEN))
+                {
+                    fprintf(stderr, "Invalid prefixes %s (nr:len, len < %u)\n", optarg, KREG_MAX_KEY_LEN);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+
+            case 'd':
+                dupPercent = (uint32_t) strtoul(optarg, NULL, 0);
+                if (dupPercent >= 100u)
+                {
+                    fprintf(stderr, "Invalid duplicate percent %s (0 - 99)\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+
+            case 'r':
+                crlf = true;
+                break;
+
+            case 'o':
+                outFileName = optarg;
+                break;
+
+            /* unknown option or missing argument */
+            default:
+                exit(EXIT_FAILURE);
+        }
+    }
+}
+
+int main( int argc, char** argv )
+{
+    FILE* out = stdout;
+    uint64_t nrOfKeys = 0;
+    uint64_t nrOfDups = 0;
+    uint32_t minKeyLen;
+
+    processCmdLineOpts(argc, argv);
+
+    /* the id has to tell apart every key */
+    for (idLen = 1, idSpace = NR_OF_KEY_CHARS; idSpace < nrOfLines; idLen++)
+    {
+        idSpace *= NR_OF_KEY_CHARS;
+    }
+
+    minKeyLen = prefixLen + idLen;
+    if (minKeyLen > KREG_MAX_KEY_LEN)
+    {
+        fprintf(stderr, "Keys of %u lines don't fit in %u characters (prefix %u, id %u)\n",
+                (unsigned) nrOfLines, KREG_MAX_KEY_LEN, prefixLen, idLen);
+        exit(EXIT_FAILURE);
+    }
+    if (keyLen.min < minKeyLen)
+    {
+        fprintf(stderr, "Key length is raised to %u-%u (prefix %u, id %u)\n",
+                minKeyLen, (keyLen.max > minKeyLen) ? keyLen.max : minKeyLen, prefixLen, idLen);
+        keyLen.min = minKeyLen;
+        keyLen.max = (keyLen.max > minKeyLen) ? keyLen.max : minKeyLen;
+    }
+
+    if ((outFileName != NULL) && ((out = fopen(outFileName, "w")) == NULL))
+    {
+        perror(outFileName);
+        exit(EXIT_FAILURE);
+    }
+    setvbuf(out, NULL, _IOFBF, OUT_BUF_SIZE);
+
+    for (uint64_t lineNr = 0; lineNr < nrOfLines; lineNr++)
+    {
+        char line[KREG_MAX_KEY_LEN + KREG_MAX_VAL_LEN + 3];
+        uint64_t random = mix(seed + mix(lineNr ^ 0x5DEECE66Dull));
+        uint32_t len;
+
+        /* a duplicate repeats the key of a random earlier line */
+        if ((nrOfKeys > 0) && (random % 100u < dupPercent))
+        {
+            len = makeKey((random >> 8) % nrOfKeys, line);
+            nrOfDups++;
+        }
+        else
+        {
+            len = makeKey(nrOfKeys++, line);
+        }
+
+        line[len++] = ' ';
+        len += makeValue(lineNr, line + len);
+
+        if (crlf)
+        {
+            line[len++] = '\r';
+        }
+        line[len++] = '\n';
+
+        fwrite(line, 1, len, out);
+    }
+
+    if ((fflush(out) != 0) || ((out != stdout) && (fclose(out) != 0)))
+    {
+        perror((outFileName != NULL) ? outFileName : "stdout");
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(stderr, "* %llu lines, %llu keys, %llu duplicates\n",
+            (unsigned long long) nrOfLines, (unsigned long long) nrOfKeys, (unsigned long long) nrOfDups);
+
+    exit(EXIT_SUCCESS);
+}
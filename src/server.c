@@ -1,493 +1,2738 @@
-/*
- * This program is free software: you can redistribute it and/or modify
- * it under the terms of the GNU General Public License as published by
- * the Free Software Foundation, either version 3 of the License, or
- * (at your option) any later version.
- *
- * This program is distributed in the hope that it will be useful,
- * but WITHOUT ANY WARRANTY; without even the implied warranty of
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
- * GNU General Public License for more details.
- *
- * You should have received a copy of the GNU General Public License
- * along with this program.  If not, see <http://www.gnu.org/licenses/>.
- */
-
-#include <stdio.h>
-#include <errno.h>
-#include <stdlib.h>
-#include <unistd.h>
-#include <stdbool.h>
-#include <getopt.h>
-#include <string.h>
-#include <ctype.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <netdb.h>
-
-#include "protocol.h"
-#include "keyregistry.h"
-
-/**************************************************************/
-/* ------------------- symbolic constants ------------------- */
-/**************************************************************/
-
-#define DEFAULT_PORT        5555
-#define READ_BUF_SIZE       256
-#define WRITE_BUF_SIZE      256
-#define DEFAULT_REGISTRY    "capitals.txt"
-
-/**************************************************************/
-/* ------------------- module local variables --------------- */
-/**************************************************************/
-
-static uint16_t listeningPort;
-static fd_set active_fd_set, read_fd_set;
-static char sendBuf[WRITE_BUF_SIZE];
-static char* keyRegistryFileName;
-
-/**************************************************************/
-/* ------------------- function prototypes ------------------ */
-/**************************************************************/
-
-static void setDefaultPort( void );
-static void setDefaultRegistryFile( void );
-static void createErrMsgToClient( int sock, const char* key, uint8_t kregErr, uint16_t errPos );
-static void processClientMessage( int sock, char* message );
-static void processCmdLineOpts( int nrOfArgs, char** args );
-static int createSocket( void );
-static int readSocket( int sock );
-static void addClient( int sock, struct sockaddr_in* client );
-static void removeClient( int sock );
-static void serverTask( void );
-
-/**************************************************************/
-/* ------------------- local functions ---------------------- */
-/**************************************************************/
-
-static void setDefaultPort( void )
-{
-    listeningPort = DEFAULT_PORT;
-}
-
-static void setDefaultRegistryFile( void )
-{
-    keyRegistryFileName = (char*)malloc(strlen(DEFAULT_REGISTRY));
-    sprintf(keyRegistryFileName, "%s", DEFAULT_REGISTRY);
-}
-
-/**
- * @brief Prepares server error message to a client
- *
- * When a client retreives (get) or saves (put) a key to the Keyregistry,
- * it returns error each time when the given string cannot be parsed.
- * This information is sent back to the client.
- *
- * @param[in] sock descriptor of the client
- * @param[in] key requested key by the client
- * @param[in] kregErr error code reported by the key registry module
- * @param[in] errPos character position where the error was detected
- * @return none
- */
-static void createErrMsgToClient( int sock, const char* key, uint8_t kregErr, uint16_t errPos )
-{
-    switch(kregErr)
-    {
-        case KREG_KEY_EMPTY:
-            sprintf(sendBuf, "Key has not been provided\n");
-            break;
-        case KREG_KEY_INVALID:
-            sprintf(sendBuf, "Key is invalid ... keys can contain digits and letters only\n");
-            break;
-        case KREG_KEY_TOO_LONG:
-            sprintf(sendBuf, "Key is too long ... max key length is %d\n", KREG_MAX_KEY_LEN);
-            break;
-        case KREG_KEY_NOT_FOUND:
-            sprintf(sendBuf, "Key [%s] not found in regisry\n", key);
-            break;
-        case KREG_KEY_EXISTS:
-            sprintf(sendBuf, "Key [%s] already exists, updating keys are not allowed\n", key);
-            break;
-        case KREG_VAL_TOO_LONG:
-            sprintf(sendBuf, "Value is too long ... max value length is %d\n", KREG_MAX_VAL_LEN);
-            break;
-        default:
-            sprintf(sendBuf, "Server Error\n");
-            break;
-    }
-}
-
-/**
- * @brief Processes client requests and send response back to the client.
- *
- * This function processes 3 different client commands:
- *   GET key - the server queries the key's value from the keyregistry
- *   PUT key value - the server saves the KVP in the keyregistry
- *   bye - the server disconnects the client
- * Parsing the key and the value is done by the keyregistry, this function just simply
- * passes the string (without the command).
- * After the command is executed, positive or negative response (error message)
- * is sent back to the client.
- * The message MUST start with the command, or the server won't be able to process it.
- *
- * @param[in] sock client
- * @param[in] message the whole message received from the client
- * @return none
- */
-static void processClientMessage( int sock, char* message )
-{
-    size_t messageLen = strlen(message);
-    
-    /* commands treated as not case sensitive (assuming that the first 3 char is the command) */
-    if (messageLen >= 3)
-    {
-        for (int i = 0; i < 3; i++)
-        {
-            message[i] = tolower(message[i]);
-        }
-    }
-
-    /* handle PUT key request */
-    if (strncmp("put", message, 3) == 0)
-    {
-        char* key = NULL;
-        char* value = NULL;
-        uint16_t errPos;
-        uint8_t retVal;
-        
-        if ((retVal = KREG_PutKey(message + 3, &key, &value, &errPos)) == KREG_OK)
-        {
-            sprintf(sendBuf, "[%s] <= [%s]\n", key, value);
-        }
-        else
-        {
-            createErrMsgToClient(sock, key, retVal, errPos);
-        }
-    }
-    /* handle GET key request */
-    else if (strncmp("get", message, 3) == 0)
-    {
-        char* key = NULL;
-        char* value = NULL;
-        uint16_t errPos;
-        uint8_t retVal;
-        
-        if ((retVal = KREG_GetKey(message + 3, &key, &value, &errPos)) == KREG_OK)
-        {
-            sprintf(sendBuf, "[%s] => [%s]\n", key, value);
-        }
-        else
-        {
-            createErrMsgToClient(sock, key, retVal, errPos);
-        }
-    }
-    /* handle disconnect request */
-    else if (strncmp("bye", message, 3) == 0)
-    {
-        removeClient(sock);
-        return;
-    }
-    else
-    {
-        sprintf(sendBuf, "???\n");
-    }
-    
-    write(sock, sendBuf, strlen(sendBuf));
-}
-
-/**
- * @brief Processes the input parameters of the main() function
- *
- * Usage: ./binary [-p PORTNUM] [-f filename]
- *
- * If the port number is out of range [1024..65535], the default
- * port number will be used.
- * if no argument is given, the default values will be used.
- *
- * @param[in] argc nr of arguments
- * @param[in] argv arg array
- * @return none
- */
-static void processCmdLineOpts( int argc, char** argv )
-{
-    int opt;
-    _Bool pFlag = false;
-    _Bool fFlag = false;
-
-    while ((opt = getopt(argc, argv, "p:f:")) != -1)
-    {
-        switch(opt)
-        {
-            case 'p':
-            {
-                long int port = strtol(optarg, NULL, 0);
-                /* restrict arg to usable port range */
-                if ((port < 1024) || (port > UINT16_MAX))
-                {
-                    listeningPort = DEFAULT_PORT;
-                }
-                else
-                {
-                    listeningPort = port;
-                }
-                pFlag = true;
-                break;
-            }
-            
-            case 'f':
-            {
-                keyRegistryFileName = (char*)malloc(strlen(optarg));
-                sprintf(keyRegistryFileName, "%s", optarg);
-                fFlag = true;
-                break;
-            }
-
-            case '?':
-                if (optopt == 'p')
-                {
-                    setDefaultPort();
-                }
-                else if (optopt == 'f')
-                {
-                    setDefaultRegistryFile();
-                }
-                else
-                {
-                    fprintf (stderr, "Unknown option character: 0x%X\n", optopt);
-                }
-                break;
-                
-            default:
-                break;
-        }
-    }
-    
-    if (!pFlag)
-    {
-        setDefaultPort();
-    }
-    
-    if (!fFlag)
-    {
-        setDefaultRegistryFile();
-    }
-}
-
-/**
- * @brief Creates a socket for accepting client connections
- *
- * In case of any error, the program terminates, therefore the return value
- * is not checked for error outside of this function.
- *
- * @return socket descriptor
- */
-static int createSocket( void )
-{
-    int sock;
-    struct sockaddr_in name;
-
-    /* Create the socket. */
-    sock = socket(PF_INET, SOCK_STREAM, 0);
-    if (sock < 0)
-    {
-        perror("create socket");
-        exit(EXIT_FAILURE);
-    }
-
-    name.sin_family = AF_INET;
-    name.sin_port = htons(listeningPort);
-    name.sin_addr.s_addr = htonl(INADDR_ANY);
-    if (bind (sock, (struct sockaddr*) &name, sizeof (name)) < 0)
-    {
-        perror("bind socket");
-        exit(EXIT_FAILURE);
-    }
-    
-    return sock;
-}
-
-/**
- * @brief Reading data from a client socket
- *
- * @param[in] sock socket to be read from
- * @return 0 if all data have been read from the socket
- *         1 if the client closed the connection
- */
-static int readSocket( int sock )
-{
-    char buffer[READ_BUF_SIZE];
-    int nbytes;
-    
-    /* Data read. */
-    nbytes = read(sock, buffer, READ_BUF_SIZE);
-    if (nbytes < 0)
-    {
-        /* Read error. */
-        perror("read socket");
-        exit(EXIT_FAILURE);
-    }
-    /* EOF (client closed the connection) */
-    else if (nbytes == 0)
-    {
-        return -1;
-    }
-    else
-    {
-        /* process client request */
-        buffer[nbytes] = '\0';
-        processClientMessage(sock, buffer);
-        return 0;
-    }
-}
-
-/**
- * @brief Remove client socket from the descriptor set
- *
- * @param[in] sock socket to be removed
- * @return none
- */
-static void removeClient( int sock )
-{
-    struct sockaddr_in client;
-    socklen_t len = sizeof(client);
-    
-    /* get client address information to display */
-    getpeername(sock, (struct sockaddr*)&client, &len);   
-    fprintf(stdout, "* Client disconnected from host %s:%d\n", inet_ntoa (client.sin_addr), ntohs (client.sin_port));
-    close(sock);
-    FD_CLR(sock, &active_fd_set);
-}
-
-/**
- * @brief Add client socket to the descriptor set
- *
- * @param[in] sock socket to be added
- * @param[in] client client address information to display
- * @return none
- */
-static void addClient( int sock, struct sockaddr_in* client )
-{
-    fprintf(stdout, "* Client connected from host %s:%d\n", inet_ntoa(client->sin_addr), ntohs(client->sin_port));
-    FD_SET(sock, &active_fd_set);
-}
-
-/**
- * @brief Implements a non-blocking task to accept client connections and read data
- *
- * @return none
- */
-static void serverTask( void )
-{
-    int sock;
-    int i;
-
-    /* Create the socket and set it up to accept connections. */
-    sock = createSocket();
-  
-    if (listen(sock, 1) < 0)
-    {
-        perror("listen");
-        exit(EXIT_FAILURE);
-    }
-    
-    /* Server is started and ready to accept connections */
-    fprintf(stdout, "* Server is started and listening on port %d\n", listeningPort);
-
-    /* Initialize the set of active sockets. */
-    FD_ZERO(&active_fd_set);
-    FD_SET(sock, &active_fd_set);
-
-    for (;;)
-    {
-        /* Block until input arrives on one or more active sockets. */
-        read_fd_set = active_fd_set;
-        if (select(FD_SETSIZE, &read_fd_set, NULL, NULL, NULL) < 0)
-        {
-          perror ("select");
-          exit (EXIT_FAILURE);
-        }
-
-        /* Service all the sockets with input pending. */
-        for (i = 0; i < FD_SETSIZE; ++i)
-        {
-            if (FD_ISSET (i, &read_fd_set))
-            {
-                if (i == sock)
-                {
-                    /* Connection request on original socket. */
-                    int new;
-                    struct sockaddr_in clientname;
-                    size_t size = sizeof (clientname);
-                    new = accept(sock, (struct sockaddr*) &clientname, (socklen_t*) &size);
-                    if (new < 0)
-                    {
-                        perror ("accept");
-                    }
-                    addClient(new, &clientname);
-                }
-                else
-                {
-                    /* Data arriving on an already-connected socket. */
-                    if (readSocket(i) < 0)
-                    {
-                        removeClient(i);
-                    }
-                }
-            }
-        }
-    }
-}
-
-int main( int argc, char** argv )
-{
-    uint16_t lineNr = 0;
-    uint16_t colNr = 0;
-
-    processCmdLineOpts(argc, argv);
-    
-    uint8_t res = KREG_ReadRegistryFile(keyRegistryFileName, &lineNr, &colNr);
-    
-    switch(res)
-    {
-        case KREG_OK:
-            fprintf(stdout, "* KVP Registry has been loaded\n");
-            break;
-            
-        case KREG_ERR_REG_OPEN:
-            fprintf(stderr, "Can't open %s\n", keyRegistryFileName);
-            exit(EXIT_FAILURE);
-            break;
-            
-        case KREG_KEY_EMPTY:
-            fprintf(stderr, "Missing key at [%d,%d]\n", lineNr, colNr);
-            exit(EXIT_FAILURE);
-            break;
-
-        case KREG_KEY_INVALID:
-            fprintf(stderr, "Invalid character found at [%d,%d]\n", lineNr, colNr);
-            exit(EXIT_FAILURE);
-            break;
-            
-        case KREG_KEY_TOO_LONG:
-            fprintf(stderr, "Long key found at [%d,%d]\n", lineNr, colNr);
-            exit(EXIT_FAILURE);
-            break;
-            
-        case KREG_VAL_TOO_LONG:
-            fprintf(stderr, "Long value found at [%d,%d]\n", lineNr, colNr);
-            exit(EXIT_FAILURE);
-            break;
-
-        /* defensive block */
-        default:
-            fprintf(stderr, "FATAL ERROR\n");
-            exit(EXIT_FAILURE);
-            break;
-        
-    }
-
-    /* start listening, accepting connections and data */
-    serverTask();
-}
\ No newline at end of file
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include "protocol.h"
+#include "keyregistry.h"
+#include "wal.h"
+#include "bgsave.h"
+#include "uring.h"
+#include "stats.h"
+
+/**************************************************************/
+/* ------------------- symbolic constants ------------------- */
+/**************************************************************/
+
+#define DEFAULT_PORT        5555
+#define CONN_BUF_SIZE       4096
+#define CONN_BUF_POOL_MAX   1024u
+#define WRITE_BUF_SIZE      256
+#define SEND_IOV_MAX        16
+#define SEND_QUEUE_LIMIT    (64u * 1024u)
+#define MULTI_MAX_KEYS      (PROTOCOL_MAX_LINE_LEN / 2u)
+#define LOOKUP_BATCH_SIZE   64u
+#define DEFAULT_REGISTRY    "capitals.txt"
+#define DEFAULT_COMPACTION  (64u * 1024u * 1024u)
+#define COMPACT_LOG_SUFFIX  ".compact"
+#define BGSAVE_POLL_MS      100
+#define MAX_EVENTS          256
+#define MAX_WORKERS         256u
+#define URING_ENTRIES       1024u
+#define URING_NR_OF_BUFS    1024u
+#define URING_BUF_GROUP     0u
+
+/* protocol of a connection, it is chosen by the first bytes of the client */
+#define CONN_UNDECIDED      0u
+#define CONN_TEXT           1u
+#define CONN_BINARY         2u
+
+/* request type in the low bits of the io_uring user data (the rest is the connection) */
+#define URING_TAG_ACCEPT    0u
+#define URING_TAG_RECV      1u
+#define URING_TAG_SEND      2u
+#define URING_TAG_CANCEL    3u
+#define URING_TAG_MASK      3u
+
+/**************************************************************/
+/* ------------------- type declarations -------------------- */
+/**************************************************************/
+
+/**
+ * replies waiting for the socket to become writable (or handed over to
+ * io_uring), they are sent in order
+ */
+typedef struct SendBlock_TAG
+{
+    struct SendBlock_TAG* next;         /**< next block of the connection */
+    size_t len;                         /**< length of the data */
+    size_t offset;                      /**< bytes already sent */
+    char data[];
+} SendBlock;
+
+/**
+ * state of a client connection, it is the user data of its epoll event
+ * (or of its io_uring requests); the input and reply buffers are taken
+ * from the pool of the worker only while they hold data, so an idle
+ * connection stays small
+ */
+typedef struct Connection_TAG
+{
+    int sock;                           /**< client socket */
+    _Bool closed;                       /**< socket has been closed, freed after the round */
+    _Bool closing;                      /**< 'bye' received, closed when its earlier replies are sent */
+    _Bool pending;                      /**< in the list of deferred replies */
+    struct sockaddr_in addr;            /**< client address to display */
+    struct Connection_TAG* nextPending; /**< next connection with deferred replies */
+    size_t replyLen;                    /**< length of the deferred replies */
+    char* reply;                        /**< replies of the round, sent after the commit of the log (NULL: none) */
+    uint8_t protocol;                   /**< CONN_xxx */
+    size_t inputLen;                    /**< length of the received, not yet processed data */
+    _Bool skipLine;                     /**< the rest of a too long request is dropped */
+    char* input;                        /**< received data, the last request may be incomplete (NULL: none) */
+    _Bool readPaused;                   /**< requests are not read till the send queue drains */
+    _Bool recvArmed;                    /**< multishot recv is active (io_uring) */
+    _Bool cancelArmed;                  /**< cancel of the recv is in flight (io_uring) */
+    SendBlock* sendHead;                /**< replies not sent yet, oldest first */
+    SendBlock* sendTail;
+    size_t sendQueued;                  /**< bytes in the send queue */
+    struct iovec sendIov[SEND_IOV_MAX]; /**< gather list of the send in flight */
+    struct msghdr sendMsg;
+} Connection;
+
+/**
+ * name of a key registry error in the statistics
+ */
+typedef struct StatName_TAG
+{
+    uint8_t code;           /**< KREG_xxx */
+    const char* name;
+} StatName;
+
+/**************************************************************/
+/* ------------------- module local variables --------------- */
+/**************************************************************/
+
+static uint16_t listeningPort;
+static uint32_t nrOfWorkers = 1;
+static _Bool uringRequested = false;
+
+/* each worker thread has its own listener, event loop and connections */
+static __thread int epollFd;
+static __thread _Bool useUring = false;
+static __thread URING_Ring ring;
+static __thread int listeningSock;
+static __thread _Bool acceptPaused = false;
+static __thread char sendBuf[WRITE_BUF_SIZE];
+
+/* connections with replies of the current round, sent after the log has been committed */
+static __thread Connection* pendingConnections = NULL;
+
+/* unused connection buffers of the worker, linked by their first bytes */
+static __thread void* freeBuffers = NULL;
+static __thread uint32_t nrOfFreeBuffers = 0;
+
+/* background snapshot and log compaction are handled by one worker at a time */
+static pthread_mutex_t snapshotLock = PTHREAD_MUTEX_INITIALIZER;
+static char* keyRegistryFileName;
+static _Bool parallelLoad = false;
+static char* snapshotFileName = NULL;
+static char* logFileName = NULL;
+static uint8_t logSyncPolicy = WAL_SYNC_ALWAYS;
+static uint32_t logSyncIntervalMs = 0;
+static char* compactLogFileName = NULL;
+static uint64_t compactionThreshold = DEFAULT_COMPACTION;
+static _Bool compactionFailed = false;
+static uint32_t loaderThreads = 0;
+
+/**************************************************************/
+/* ------------------- function prototypes ------------------ */
+/**************************************************************/
+
+static void setDefaultPort( void );
+static void setDefaultRegistryFile( void );
+static void createErrMsgToClient( int sock, const KREG_StrView* key, uint8_t kregErr, uint16_t errPos );
+static size_t splitWords( const char* str, KREG_StrView* words, size_t maxWords );
+static void processMultiGet( Connection* conn, const char* args );
+static void processMultiPut( Connection* conn, const char* args );
+static void countLookup( uint8_t kregErr );
+static void processStats( Connection* conn );
+static void processClientMessage( Connection* conn, char* message );
+static void rejectLongRequest( Connection* conn );
+static void processLines( Connection* conn );
+static uint8_t frameStatus( uint8_t kregErr );
+static void processFrame( Connection* conn, const PROTOCOL_Header* request, const char* payload );
+static size_t processGetFrames( Connection* conn, size_t pos );
+static size_t processFrames( Connection* conn, size_t pos );
+static void processInput( Connection* conn );
+static void processCmdLineOpts( int nrOfArgs, char** args );
+static void loadRegistryFile( void );
+static _Bool loadSnapshot( void );
+static void writeSnapshot( void );
+static void replayRecord( const char* key, uint8_t keyLen, const char* value, uint8_t valLen );
+static void openLog( void );
+static void addPending( Connection* conn );
+static void appendSendBlock( Connection* conn, const char* data, size_t len );
+static void prepareSendMsg( Connection* conn );
+static void consumeSent( Connection* conn, size_t len );
+static void dropSends( Connection* conn );
+static void closeIfFlushed( Connection* conn );
+static char* getBuffer( void );
+static void putBuffer( char* buf );
+static _Bool reserveInput( Connection* conn );
+static void releaseInput( Connection* conn );
+static void sendReplyData( Connection* conn, const void* data, size_t len );
+static void sendReply( Connection* conn, const char* reply );
+static void commitRound( _Bool endOfRound );
+static uint8_t startSnapshot( void );
+static void finishSnapshot( void );
+static void compactLog( void );
+static void maintainSnapshot( void );
+static int createSocket( void );
+static void* workerTask( void* arg );
+static void raiseDescriptorLimit( void );
+static void readSocket( Connection* conn );
+static void sendReplies( Connection* conn );
+static void flushSends( Connection* conn );
+static void acceptClients( int sock );
+static void addClient( int sock, struct sockaddr_in* client );
+static void removeClient( Connection* conn );
+static void releaseConnection( Connection* conn );
+static int roundTimeout( void );
+static void serverLoopEpoll( int sock );
+static struct io_uring_sqe* getSqe( void );
+static void armAccept( void );
+static void armRecv( Connection* conn );
+static void queueSend( Connection* conn );
+static void cancelRecv( Connection* conn );
+static void handleCompletion( uint64_t userData, int32_t res, uint32_t flags );
+static _Bool startUring( void );
+static void serverLoopUring( void );
+static void serverTask( int sock );
+static void startWorkers( void );
+
+/**************************************************************/
+/* ------------------- local functions ---------------------- */
+/**************************************************************/
+
+static void setDefaultPort( void )
+{
+    listeningPort = DEFAULT_PORT;
+}
+
+static void setDefaultRegistryFile( void )
+{
+    keyRegistryFileName = (char*)malloc(strlen(DEFAULT_REGISTRY));
+    sprintf(keyRegistryFileName, "%s", DEFAULT_REGISTRY);
+}
+
+/**
+ * @brief Prepares server error message to a client
+ *
+ * When a client retreives (get) or saves (put) a key to the Keyregistry,
+ * it returns error each time when the given string cannot be parsed.
+ * This information is sent back to the client.
+ *
+ * @param[in] sock descriptor of the client
+ * @param[in] key requested key by the client
+ * @param[in] kregErr error code reported by the key registry module
+ * @param[in] errPos character position where the error was detected
+ * @return none
+ */
+static void createErrMsgToClient( int sock, const KREG_StrView* key, uint8_t kregErr, uint16_t errPos )
+{
+    switch(kregErr)
+    {
+        case KREG_KEY_EMPTY:
+            sprintf(sendBuf, "Key has not been provided\n");
+            break;
+        case KREG_KEY_INVALID:
+            sprintf(sendBuf, "Key is invalid ... keys can contain digits and letters only\n");
+            break;
+        case KREG_KEY_TOO_LONG:
+            sprintf(sendBuf, "Key is too long ... max key length is %d\n", KREG_MAX_KEY_LEN);
+            break;
+        case KREG_KEY_NOT_FOUND:
+            sprintf(sendBuf, "Key [%.*s] not found in regisry\n", key->len, key->ptr);
+            break;
+        case KREG_KEY_EXISTS:
+            sprintf(sendBuf, "Key [%.*s] already exists, updating keys are not allowed\n", key->len, key->ptr);
+            break;
+        case KREG_VAL_TOO_LONG:
+            sprintf(sendBuf, "Value is too long ... max value length is %d\n", KREG_MAX_VAL_LEN);
+            break;
+        default:
+            sprintf(sendBuf, "Server Error\n");
+            break;
+    }
+}
+
+/**
+ * @brief Splits the arguments of a request into words
+ *
+ * The words are separated by spaces (or tabs), a word longer than a
+ * value is cut at KREG_MAX_VAL_LEN + 1 characters, so it is still
+ * reported as too long (as a key or as a value).
+ *
+ * @param[in] str zero terminated arguments
+ * @param[out] words views of the words into the arguments
+ * @param[in] maxWords size of the words array
+ * @return number of words
+ */
+static size_t splitWords( const char* str, KREG_StrView* words, size_t maxWords )
+{
+    size_t nrOfWords = 0;
+
+    while (nrOfWords < maxWords)
+    {
+        size_t len;
+
+        str += strspn(str, " \t\r");
+        if ((len = strcspn(str, " \t\r")) == 0)
+        {
+            break;
+        }
+
+        words[nrOfWords].ptr = str;
+        words[nrOfWords].len = (uint8_t)((len > KREG_MAX_VAL_LEN) ? KREG_MAX_VAL_LEN + 1 : len);
+        nrOfWords++;
+        str += len;
+    }
+
+    return nrOfWords;
+}
+
+/**
+ * @brief Processes an MGET request, the value of each key is a reply line
+ *
+ * The keys are looked up in batches (see KREG_LookupKeys()), so the
+ * lookups don't wait for the memory one by one.
+ *
+ * @param[in] conn client connection
+ * @param[in] args keys separated by spaces
+ * @return none
+ */
+static void processMultiGet( Connection* conn, const char* args )
+{
+    KREG_StrView keys[MULTI_MAX_KEYS];
+    KREG_Value values[LOOKUP_BATCH_SIZE];
+    uint8_t results[LOOKUP_BATCH_SIZE];
+    size_t nrOfKeys = splitWords(args, keys, MULTI_MAX_KEYS);
+
+    if (nrOfKeys == 0)
+    {
+        STATS_CountError(KREG_KEY_EMPTY);
+        sendReply(conn, "Key has not been provided\n");
+        return;
+    }
+
+    for (size_t first = 0; (first < nrOfKeys) && !conn->closed; first += LOOKUP_BATCH_SIZE)
+    {
+        size_t count = ((nrOfKeys - first) < LOOKUP_BATCH_SIZE) ? (nrOfKeys - first) : LOOKUP_BATCH_SIZE;
+
+        KREG_LookupKeys(&keys[first], count, values, results);
+
+        for (size_t i = 0; (i < count) && !conn->closed; i++)
+        {
+            const KREG_StrView* key = &keys[first + i];
+
+            countLookup(results[i]);
+            if (results[i] == KREG_OK)
+            {
+                int len = snprintf(sendBuf, sizeof(sendBuf), "[%.*s] => [%s]\n", key->len, key->ptr, values[i].str);
+
+                /* a found key and its value always fit, a cut line is never sent */
+                if ((len < 0) || ((size_t)len >= sizeof(sendBuf)))
+                {
+                    sprintf(sendBuf, "Server Error\n");
+                }
+            }
+            else
+            {
+                createErrMsgToClient(conn->sock, key, results[i], 0);
+            }
+            sendReply(conn, sendBuf);
+        }
+    }
+}
+
+/**
+ * @brief Processes an MPUT request, the result of each pair is a reply line
+ *
+ * The values can't contain spaces. Nothing is stored if a value is missing.
+ *
+ * @param[in] conn client connection
+ * @param[in] args key value pairs separated by spaces
+ * @return none
+ */
+static void processMultiPut( Connection* conn, const char* args )
+{
+    KREG_StrView words[MULTI_MAX_KEYS];
+    size_t nrOfWords = splitWords(args, words, MULTI_MAX_KEYS);
+    uint8_t retVal;
+
+    if ((nrOfWords == 0) || (nrOfWords % 2 != 0))
+    {
+        STATS_Add(STATS_BAD_REQUESTS, 1);
+        sendReply(conn, "MPUT needs key value pairs\n");
+        return;
+    }
+
+    for (size_t i = 0; i < nrOfWords; i += 2)
+    {
+        KREG_PrefetchKey(&words[i]);
+    }
+
+    /* the pairs after a broken connection are not stored */
+    for (size_t i = 0; (i < nrOfWords) && !conn->closed; i += 2)
+    {
+        /* the PUT is logged by logRecord(), the reply is deferred till the record is committed */
+        if ((retVal = KREG_StoreKeyValue(&words[i], &words[i + 1])) == KREG_OK)
+        {
+            STATS_Add(STATS_PUTS, 1);
+            sprintf(sendBuf, "[%.*s] <= [%.*s]\n", words[i].len, words[i].ptr, words[i + 1].len, words[i + 1].ptr);
+        }
+        else
+        {
+            STATS_CountError(retVal);
+            createErrMsgToClient(conn->sock, &words[i], retVal, 0);
+        }
+        sendReply(conn, sendBuf);
+    }
+}
+
+/**
+ * @brief Counts the result of a key lookup
+ *
+ * @param[in] kregErr result of the lookup
+ * @return none
+ */
+static void countLookup( uint8_t kregErr )
+{
+    if (kregErr == KREG_OK)
+    {
+        STATS_Add(STATS_GET_HITS, 1);
+    }
+    else if (kregErr == KREG_KEY_NOT_FOUND)
+    {
+        STATS_Add(STATS_GET_MISSES, 1);
+    }
+    else
+    {
+        STATS_CountError(kregErr);
+    }
+}
+
+/**
+ * @brief Sends the statistics of the server, one "STAT name value" line each, closed by "END"
+ *
+ * The service times are in microseconds.
+ *
+ * @param[in] conn client connection
+ * @return none
+ */
+static void processStats( Connection* conn )
+{
+    static const StatName errors[] =
+    {
+        { KREG_KEY_EMPTY,       "key_empty" },
+        { KREG_KEY_INVALID,     "key_invalid" },
+        { KREG_KEY_TOO_LONG,    "key_too_long" },
+        { KREG_VAL_TOO_LONG,    "val_too_long" },
+        { KREG_KEY_EXISTS,      "key_exists" },
+        { KREG_ERR_NO_MEM,      "no_mem" }
+    };
+    static const char* commands[STATS_NR_OF_CMDS] = { "get", "put", "mget", "mput", "save", "stats" };
+    STATS_Totals totals;
+
+    if (STATS_Collect(&totals) != STATS_OK)
+    {
+        sendReply(conn, "Server Error\n");
+        return;
+    }
+
+    sprintf(sendBuf, "STAT connections %llu\n",
+            (unsigned long long)(totals.counters[STATS_CONNS_OPENED] - totals.counters[STATS_CONNS_CLOSED]));
+    sendReply(conn, sendBuf);
+    sprintf(sendBuf, "STAT bytes_in %llu\n", (unsigned long long) totals.counters[STATS_BYTES_IN]);
+    sendReply(conn, sendBuf);
+    sprintf(sendBuf, "STAT bytes_out %llu\n", (unsigned long long) totals.counters[STATS_BYTES_OUT]);
+    sendReply(conn, sendBuf);
+    sprintf(sendBuf, "STAT get_hits %llu\n", (unsigned long long) totals.counters[STATS_GET_HITS]);
+    sendReply(conn, sendBuf);
+    sprintf(sendBuf, "STAT get_misses %llu\n", (unsigned long long) totals.counters[STATS_GET_MISSES]);
+    sendReply(conn, sendBuf);
+    sprintf(sendBuf, "STAT puts %llu\n", (unsigned long long) totals.counters[STATS_PUTS]);
+    sendReply(conn, sendBuf);
+    sprintf(sendBuf, "STAT bad_requests %llu\n", (unsigned long long) totals.counters[STATS_BAD_REQUESTS]);
+    sendReply(conn, sendBuf);
+
+    for (size_t i = 0; i < sizeof(errors) / sizeof(errors[0]); i++)
+    {
+        sprintf(sendBuf, "STAT err_%s %llu\n", errors[i].name, (unsigned long long) totals.errors[errors[i].code]);
+        sendReply(conn, sendBuf);
+    }
+
+    for (uint32_t i = 0; i < STATS_NR_OF_CMDS; i++)
+    {
+        const STATS_Latency* latency = &totals.commands[i];
+
+        sprintf(sendBuf, "STAT cmd_%s %llu p50 %.1f p99 %.1f p99.9 %.1f max %.1f\n", commands[i],
+                (unsigned long long) latency->count, latency->p50 / 1000.0, latency->p99 / 1000.0,
+                latency->p999 / 1000.0, latency->max / 1000.0);
+        sendReply(conn, sendBuf);
+    }
+
+    sendReply(conn, "END\n");
+}
+
+/**
+ * @brief Processes client requests and send response back to the client.
+ *
+ * This function processes the following client commands:
+ *   GET key - the server queries the key's value from the keyregistry
+ *   PUT key value - the server saves the KVP in the keyregistry
+ *   MGET key... / MPUT key value... - several keys in one request
+ *   SAVE - the server writes a snapshot in the background
+ *   STATS - the server sends its statistics
+ *   bye - the server disconnects the client
+ * Parsing the key and the value is done by the keyregistry, this function just simply
+ * passes the string (without the command).
+ * After the command is executed, positive or negative response (error message)
+ * is sent back to the client. The service time of the command is recorded till then.
+ * The message MUST start with the command, or the server won't be able to process it.
+ *
+ * @param[in] conn client connection
+ * @param[in] message one request line received from the client (without the line end)
+ * @return none
+ */
+static void processClientMessage( Connection* conn, char* message )
+{
+    size_t messageLen = strlen(message);
+    uint64_t start = STATS_Now();
+    uint8_t cmd = STATS_NR_OF_CMDS;
+    
+    /* commands treated as not case sensitive (assuming that the first 3 char is the command) */
+    if (messageLen >= 3)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            message[i] = tolower(message[i]);
+        }
+    }
+
+    /* handle multi-key requests, each key gets its own reply line */
+    if (strncasecmp("mget", message, 4) == 0)
+    {
+        processMultiGet(conn, message + 4);
+        STATS_RecordCommand(STATS_CMD_MGET, start);
+        return;
+    }
+    else if (strncasecmp("mput", message, 4) == 0)
+    {
+        processMultiPut(conn, message + 4);
+        STATS_RecordCommand(STATS_CMD_MPUT, start);
+        return;
+    }
+    /* handle statistics request, it has a reply line for each statistic */
+    else if (strncasecmp("stats", message, 5) == 0)
+    {
+        processStats(conn);
+        STATS_RecordCommand(STATS_CMD_STATS, start);
+        return;
+    }
+    /* handle PUT key request */
+    else if (strncmp("put", message, 3) == 0)
+    {
+        char* key = NULL;
+        char* value = NULL;
+        uint16_t errPos;
+        uint8_t retVal;
+        
+        /* the PUT is logged by logRecord(), the reply is deferred till the record is committed */
+        retVal = KREG_PutKey(message + 3, &key, &value, &errPos);
+        cmd = STATS_CMD_PUT;
+
+        if (retVal == KREG_OK)
+        {
+            STATS_Add(STATS_PUTS, 1);
+            sprintf(sendBuf, "[%s] <= [%s]\n", key, value);
+        }
+        else
+        {
+            KREG_StrView keyView = { key, (uint8_t)((key != NULL) ? strlen(key) : 0) };
+
+            STATS_CountError(retVal);
+            createErrMsgToClient(conn->sock, &keyView, retVal, errPos);
+        }
+    }
+    /* handle GET key request */
+    else if (strncmp("get", message, 3) == 0)
+    {
+        KREG_StrView key;
+        KREG_Value value;
+        uint16_t errPos;
+        uint8_t retVal;
+        
+        cmd = STATS_CMD_GET;
+
+        /* the key is parsed as a view into the receive buffer, nothing is allocated */
+        retVal = KREG_GetKeyView(message + 3, messageLen - 3, &key, &value, &errPos);
+        countLookup(retVal);
+
+        if (retVal == KREG_OK)
+        {
+            sprintf(sendBuf, "[%.*s] => [%s]\n", key.len, key.ptr, value.str);
+        }
+        else
+        {
+            createErrMsgToClient(conn->sock, &key, retVal, errPos);
+        }
+    }
+    /* handle snapshot request (it doesn't block the other clients) */
+    else if (strncasecmp("save", message, 4) == 0)
+    {
+        uint8_t retVal;
+
+        pthread_mutex_lock(&snapshotLock);
+        retVal = startSnapshot();
+        pthread_mutex_unlock(&snapshotLock);
+        cmd = STATS_CMD_SAVE;
+
+        switch (retVal)
+        {
+            case BGSAVE_OK:
+                sprintf(sendBuf, "Snapshot is being written in the background\n");
+                break;
+
+            case BGSAVE_ERR_BUSY:
+                sprintf(sendBuf, "Snapshot is already in progress\n");
+                break;
+
+            default:
+                sprintf(sendBuf, "Snapshot cannot be written\n");
+                break;
+        }
+    }
+    /* handle disconnect request, the replies of the earlier requests are sent first */
+    else if (strncmp("bye", message, 3) == 0)
+    {
+        conn->closing = true;
+        addPending(conn);
+        return;
+    }
+    else
+    {
+        STATS_Add(STATS_BAD_REQUESTS, 1);
+        sprintf(sendBuf, "???\n");
+    }
+    
+    sendReply(conn, sendBuf);
+
+    if (cmd != STATS_NR_OF_CMDS)
+    {
+        STATS_RecordCommand(cmd, start);
+    }
+}
+
+/**
+ * @brief Replies to a request which is longer than PROTOCOL_MAX_LINE_LEN
+ *
+ * @param[in] conn client connection
+ * @return none
+ */
+static void rejectLongRequest( Connection* conn )
+{
+    STATS_Add(STATS_BAD_REQUESTS, 1);
+    sprintf(sendBuf, "Request is too long ... max request length is %u\n", PROTOCOL_MAX_LINE_LEN - 1);
+    sendReply(conn, sendBuf);
+}
+
+/**
+ * @brief Processes the complete text requests received from a client
+ *
+ * The received data is split into lines, each of them is one request,
+ * so several requests can arrive in one segment and a request can be
+ * split among segments. The incomplete last line is kept for the next
+ * receive. A line longer than PROTOCOL_MAX_LINE_LEN is rejected and
+ * dropped till its end.
+ *
+ * @param[in] conn client connection
+ * @return none
+ */
+static void processLines( Connection* conn )
+{
+    char* line = conn->input;
+    char* end = conn->input + conn->inputLen;
+    char* lineEnd;
+    size_t rest;
+
+    /* the requests are processed till the client disconnects */
+    while (!conn->closed && !conn->closing && ((lineEnd = memchr(line, PROTOCOL_EOL, end - line)) != NULL))
+    {
+        *lineEnd = '\0';
+
+        if (conn->skipLine)
+        {
+            conn->skipLine = false;
+        }
+        else if ((size_t)(lineEnd - line) >= PROTOCOL_MAX_LINE_LEN)
+        {
+            rejectLongRequest(conn);
+        }
+        else
+        {
+            processClientMessage(conn, line);
+        }
+        line = lineEnd + 1;
+    }
+
+    rest = end - line;
+
+    /* the end of a too long request is dropped when it arrives */
+    if (rest >= PROTOCOL_MAX_LINE_LEN)
+    {
+        if (!conn->skipLine)
+        {
+            rejectLongRequest(conn);
+            conn->skipLine = true;
+        }
+        rest = 0;
+    }
+
+    memmove(conn->input, line, rest);
+    conn->inputLen = rest;
+}
+
+/**
+ * @brief Converts a key registry error to the status of a binary reply
+ *
+ * @param[in] kregErr error code reported by the key registry module
+ * @return PROTOCOL_ST_xxx
+ */
+static uint8_t frameStatus( uint8_t kregErr )
+{
+    switch (kregErr)
+    {
+        case KREG_OK:
+            return PROTOCOL_ST_OK;
+        case KREG_KEY_EMPTY:
+            return PROTOCOL_ST_KEY_EMPTY;
+        case KREG_KEY_INVALID:
+            return PROTOCOL_ST_KEY_INVALID;
+        case KREG_KEY_TOO_LONG:
+            return PROTOCOL_ST_KEY_TOO_LONG;
+        case KREG_KEY_NOT_FOUND:
+            return PROTOCOL_ST_KEY_NOT_FOUND;
+        case KREG_KEY_EXISTS:
+            return PROTOCOL_ST_KEY_EXISTS;
+        case KREG_VAL_TOO_LONG:
+            return PROTOCOL_ST_VAL_TOO_LONG;
+        default:
+            return PROTOCOL_ST_ERROR;
+    }
+}
+
+/**
+ * @brief Processes a binary request and sends its reply
+ *
+ * The key and the value are taken as they are, only the key is
+ * validated, so nothing has to be parsed or formatted. GETs are
+ * processed by processGetFrames().
+ *
+ * @param[in] conn client connection
+ * @param[in] request header of the request
+ * @param[in] payload key and value of the request
+ * @return none
+ */
+static void processFrame( Connection* conn, const PROTOCOL_Header* request, const char* payload )
+{
+    KREG_StrView key = { payload, request->keyLen };
+    KREG_StrView value = { payload + request->keyLen, request->valLen };
+    PROTOCOL_Header reply = { request->opcode, PROTOCOL_ST_OK, 0, 0, request->requestId };
+    uint64_t start = STATS_Now();
+    uint8_t cmd = STATS_NR_OF_CMDS;
+
+    switch (request->opcode)
+    {
+        case PROTOCOL_OP_PUT:
+        {
+            uint8_t retVal;
+
+            cmd = STATS_CMD_PUT;
+
+            /* a stored value must be a valid reply line of the text protocol too */
+            if ((memchr(value.ptr, PROTOCOL_EOL, value.len) != NULL) || (memchr(value.ptr, '\0', value.len) != NULL))
+            {
+                STATS_Add(STATS_BAD_REQUESTS, 1);
+                reply.status = PROTOCOL_ST_VAL_INVALID;
+            }
+            /* the PUT is logged by logRecord(), the reply is deferred till the record is committed */
+            else if ((retVal = KREG_StoreKeyValue(&key, &value)) == KREG_OK)
+            {
+                STATS_Add(STATS_PUTS, 1);
+            }
+            else
+            {
+                STATS_CountError(retVal);
+                reply.status = frameStatus(retVal);
+            }
+            break;
+        }
+
+        case PROTOCOL_OP_SAVE:
+        {
+            uint8_t retVal;
+
+            pthread_mutex_lock(&snapshotLock);
+            retVal = startSnapshot();
+            pthread_mutex_unlock(&snapshotLock);
+            cmd = STATS_CMD_SAVE;
+
+            reply.status = (retVal == BGSAVE_OK) ? PROTOCOL_ST_OK : ((retVal == BGSAVE_ERR_BUSY) ? PROTOCOL_ST_BUSY : PROTOCOL_ST_ERROR);
+            break;
+        }
+
+        /* the replies of the earlier requests are sent first, see closeIfFlushed() */
+        case PROTOCOL_OP_BYE:
+        {
+            conn->closing = true;
+            addPending(conn);
+            return;
+        }
+
+        default:
+        {
+            STATS_Add(STATS_BAD_REQUESTS, 1);
+            reply.status = PROTOCOL_ST_BAD_REQUEST;
+            break;
+        }
+    }
+
+    sendReplyData(conn, &reply, sizeof(reply));
+
+    if (cmd != STATS_NR_OF_CMDS)
+    {
+        STATS_RecordCommand(cmd, start);
+    }
+}
+
+/**
+ * @brief Processes a run of binary GET requests and sends their replies
+ *
+ * The complete GET frames following each other (at most
+ * LOOKUP_BATCH_SIZE) are looked up together, see KREG_LookupKeys().
+ *
+ * @param[in] conn client connection
+ * @param[in] pos start of the first GET frame in the input
+ * @return end of the processed frames in the input
+ */
+static size_t processGetFrames( Connection* conn, size_t pos )
+{
+    PROTOCOL_Header requests[LOOKUP_BATCH_SIZE];
+    KREG_StrView keys[LOOKUP_BATCH_SIZE];
+    KREG_Value values[LOOKUP_BATCH_SIZE];
+    uint8_t results[LOOKUP_BATCH_SIZE];
+    size_t count = 0;
+    uint64_t start = STATS_Now();
+
+    while ((count < LOOKUP_BATCH_SIZE) && (conn->inputLen - pos >= sizeof(PROTOCOL_Header)))
+    {
+        PROTOCOL_Header* request = &requests[count];
+
+        memcpy(request, conn->input + pos, sizeof(*request));
+        if ((request->opcode != PROTOCOL_OP_GET)
+            || (conn->inputLen - pos < sizeof(*request) + request->keyLen + request->valLen))
+        {
+            break;
+        }
+
+        keys[count].ptr = conn->input + pos + sizeof(*request);
+        keys[count].len = request->keyLen;
+        pos += sizeof(*request) + request->keyLen + request->valLen;
+        count++;
+    }
+
+    KREG_LookupKeys(keys, count, values, results);
+
+    for (size_t i = 0; (i < count) && !conn->closed; i++)
+    {
+        PROTOCOL_Header reply = { PROTOCOL_OP_GET, frameStatus(results[i]), 0, 0, requests[i].requestId };
+
+        countLookup(results[i]);
+
+        /* the value follows the header in the same reply */
+        if (results[i] == KREG_OK)
+        {
+            reply.valLen = values[i].len;
+        }
+        memcpy(sendBuf, &reply, sizeof(reply));
+        memcpy(sendBuf + sizeof(reply), values[i].str, reply.valLen);
+        sendReplyData(conn, sendBuf, sizeof(reply) + reply.valLen);
+    }
+
+    /* the lookups overlap, each GET gets an equal share of the batch */
+    STATS_RecordCommands(STATS_CMD_GET, start, (uint32_t) count);
+
+    return pos;
+}
+
+/**
+ * @brief Processes the complete binary requests received from a client
+ *
+ * A frame is at most a header and two maximum lengths, so an incomplete
+ * frame always fits in the input buffer.
+ *
+ * @param[in] conn client connection
+ * @param[in] pos start of the first frame in the input
+ * @return length of the processed input
+ */
+static size_t processFrames( Connection* conn, size_t pos )
+{
+    PROTOCOL_Header request;
+    size_t frameLen;
+
+    while (!conn->closed && !conn->closing && (conn->inputLen - pos >= sizeof(request)))
+    {
+        /* the header may be unaligned in the input */
+        memcpy(&request, conn->input + pos, sizeof(request));
+
+        frameLen = sizeof(request) + request.keyLen + request.valLen;
+        if (conn->inputLen - pos < frameLen)
+        {
+            break;
+        }
+
+        if (request.opcode == PROTOCOL_OP_GET)
+        {
+            pos = processGetFrames(conn, pos);
+            continue;
+        }
+
+        processFrame(conn, &request, conn->input + pos + sizeof(request));
+        pos += frameLen;
+    }
+
+    return pos;
+}
+
+/**
+ * @brief Processes the complete requests received from a client
+ *
+ * The protocol of the connection is chosen by its first byte: the hello
+ * of the binary protocol or the first letter of a text request.
+ *
+ * @param[in] conn client connection
+ * @return none
+ */
+static void processInput( Connection* conn )
+{
+    size_t pos = 0;
+
+    if (conn->protocol == CONN_UNDECIDED)
+    {
+        if ((uint8_t)conn->input[0] != PROTOCOL_BIN_MAGIC)
+        {
+            conn->protocol = CONN_TEXT;
+        }
+        else if (conn->inputLen >= PROTOCOL_HELLO_LEN)
+        {
+            /* the client adapts to the version of the server */
+            const uint8_t hello[PROTOCOL_HELLO_LEN] = { PROTOCOL_BIN_MAGIC, PROTOCOL_BIN_VERSION };
+
+            sendReplyData(conn, hello, sizeof(hello));
+            conn->protocol = CONN_BINARY;
+            pos = PROTOCOL_HELLO_LEN;
+        }
+        else
+        {
+            return;
+        }
+    }
+
+    if (conn->protocol == CONN_TEXT)
+    {
+        processLines(conn);
+    }
+    else
+    {
+        pos = processFrames(conn, pos);
+
+        memmove(conn->input, conn->input + pos, conn->inputLen - pos);
+        conn->inputLen -= pos;
+    }
+
+    releaseInput(conn);
+}
+
+/**
+ * @brief Processes the input parameters of the main() function
+ *
+ * Usage: ./binary [-p PORTNUM] [-f filename] [-j threads] [-s snapshot] [-l logfile] [-y sync] [-c size] [-b backend] [-w workers]
+ *
+ * If the port number is out of range [1024..65535], the default
+ * port number will be used.
+ * if no argument is given, the default values will be used.
+ * The -j option selects the memory mapped registry loader with the given
+ * number of parser threads (0: one thread per CPU).
+ * The -s option enables the binary snapshot: if the snapshot exists, it is
+ * loaded instead of the registry file, otherwise it is created after the
+ * registry file has been loaded.
+ * The -l option enables the write-ahead log of PUTs, -y sets its fsync policy:
+ * 'always' (default), 'never' or the sync interval in milliseconds.
+ * If both the snapshot and the log are enabled, the log is compacted in the
+ * background when it grows over the size given by -c (in bytes).
+ * The -b option selects the I/O backend: 'epoll' (default) or 'uring'.
+ * The -w option starts the given number of worker threads, each of them
+ * with its own SO_REUSEPORT listener and event loop.
+ *
+ * @param[in] argc nr of arguments
+ * @param[in] argv arg array
+ * @return none
+ */
+static void processCmdLineOpts( int argc, char** argv )
+{
+    int opt;
+    _Bool pFlag = false;
+    _Bool fFlag = false;
+
+    while ((opt = getopt(argc, argv, "p:f:j:s:l:y:c:b:w:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'p':
+            {
+                long int port = strtol(optarg, NULL, 0);
+                /* restrict arg to usable port range */
+                if ((port < 1024) || (port > UINT16_MAX))
+                {
+                    listeningPort = DEFAULT_PORT;
+                }
+                else
+                {
+                    listeningPort = port;
+                }
+                pFlag = true;
+                break;
+            }
+            
+            case 'f':
+            {
+                keyRegistryFileName = (char*)malloc(strlen(optarg));
+                sprintf(keyRegistryFileName, "%s", optarg);
+                fFlag = true;
+                break;
+            }
+
+            case 'j':
+            {
+                long int threads = strtol(optarg, NULL, 0);
+                loaderThreads = (threads > 0) ? threads : 0;
+                parallelLoad = true;
+                break;
+            }
+
+            case 's':
+            {
+                snapshotFileName = (char*)malloc(strlen(optarg) + 1);
+                sprintf(snapshotFileName, "%s", optarg);
+                break;
+            }
+
+            case 'l':
+            {
+                logFileName = (char*)malloc(strlen(optarg) + 1);
+                sprintf(logFileName, "%s", optarg);
+                compactLogFileName = (char*)malloc(strlen(optarg) + sizeof(COMPACT_LOG_SUFFIX));
+                sprintf(compactLogFileName, "%s%s", optarg, COMPACT_LOG_SUFFIX);
+                break;
+            }
+
+            case 'b':
+            {
+                if ((strcmp(optarg, "uring") != 0) && (strcmp(optarg, "epoll") != 0))
+                {
+                    fprintf(stderr, "Invalid backend %s ('epoll' or 'uring')\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                uringRequested = (strcmp(optarg, "uring") == 0);
+                break;
+            }
+
+            case 'w':
+            {
+                char* end;
+                long int workers = strtol(optarg, &end, 10);
+
+                if ((end == optarg) || (*end != '\0') || (workers <= 0) || (workers > MAX_WORKERS))
+                {
+                    fprintf(stderr, "Invalid number of workers %s (1 - %u)\n", optarg, MAX_WORKERS);
+                    exit(EXIT_FAILURE);
+                }
+                nrOfWorkers = (uint32_t)workers;
+                break;
+            }
+
+            case 'c':
+            {
+                long long int size = strtoll(optarg, NULL, 0);
+                compactionThreshold = (size > 0) ? size : DEFAULT_COMPACTION;
+                break;
+            }
+
+            case 'y':
+            {
+                if (strcmp(optarg, "always") == 0)
+                {
+                    logSyncPolicy = WAL_SYNC_ALWAYS;
+                }
+                else if (strcmp(optarg, "never") == 0)
+                {
+                    logSyncPolicy = WAL_SYNC_NEVER;
+                }
+                else
+                {
+                    char* end;
+                    long int interval = strtol(optarg, &end, 10);
+
+                    if ((end == optarg) || (*end != '\0') || (interval <= 0) || (interval > INT32_MAX))
+                    {
+                        fprintf(stderr, "Invalid sync policy %s ('always', 'never' or milliseconds)\n", optarg);
+                        exit(EXIT_FAILURE);
+                    }
+                    logSyncPolicy = WAL_SYNC_INTERVAL;
+                    logSyncIntervalMs = (uint32_t) interval;
+                }
+                break;
+            }
+
+            case '?':
+                if (optopt == 'p')
+                {
+                    setDefaultPort();
+                }
+                else if (optopt == 'f')
+                {
+                    setDefaultRegistryFile();
+                }
+                else
+                {
+                    fprintf (stderr, "Unknown option character: 0x%X\n", optopt);
+                }
+                break;
+                
+            default:
+                break;
+        }
+    }
+    
+    if (!pFlag)
+    {
+        setDefaultPort();
+    }
+    
+    if (!fFlag)
+    {
+        setDefaultRegistryFile();
+    }
+}
+
+/**
+ * @brief Loads the registry file
+ *
+ * In case of any error, the program terminates with an error message.
+ *
+ * @return none
+ */
+static void loadRegistryFile( void )
+{
+    uint32_t lineNr = 0;
+    uint16_t colNr = 0;
+    uint8_t res;
+
+    if (parallelLoad)
+    {
+        res = KREG_ReadRegistryFileParallel(keyRegistryFileName, loaderThreads, &lineNr, &colNr);
+    }
+    else
+    {
+        res = KREG_ReadRegistryFile(keyRegistryFileName, &lineNr, &colNr);
+    }
+    
+    switch(res)
+    {
+        case KREG_OK:
+            fprintf(stdout, "* KVP Registry has been loaded\n");
+            break;
+            
+        case KREG_ERR_REG_OPEN:
+            fprintf(stderr, "Can't open %s\n", keyRegistryFileName);
+            exit(EXIT_FAILURE);
+            break;
+            
+        case KREG_KEY_EMPTY:
+            fprintf(stderr, "Missing key at [%u,%d]\n", lineNr, colNr);
+            exit(EXIT_FAILURE);
+            break;
+
+        case KREG_KEY_INVALID:
+            fprintf(stderr, "Invalid character found at [%u,%d]\n", lineNr, colNr);
+            exit(EXIT_FAILURE);
+            break;
+            
+        case KREG_KEY_TOO_LONG:
+            fprintf(stderr, "Long key found at [%u,%d]\n", lineNr, colNr);
+            exit(EXIT_FAILURE);
+            break;
+            
+        case KREG_VAL_TOO_LONG:
+            fprintf(stderr, "Long value found at [%u,%d]\n", lineNr, colNr);
+            exit(EXIT_FAILURE);
+            break;
+
+        case KREG_ERR_NO_MEM:
+            fprintf(stderr, "Out of memory at [%u,%d]\n", lineNr, colNr);
+            exit(EXIT_FAILURE);
+            break;
+
+        /* defensive block */
+        default:
+            fprintf(stderr, "FATAL ERROR\n");
+            exit(EXIT_FAILURE);
+            break;
+        
+    }
+}
+
+/**
+ * @brief Loads the registry from the snapshot file (if it is enabled and exists)
+ *
+ * In case of any error, the program terminates.
+ *
+ * @return true if the registry has been loaded from the snapshot
+ */
+static _Bool loadSnapshot( void )
+{
+    if ((snapshotFileName == NULL) || (access(snapshotFileName, F_OK) != 0))
+    {
+        return false;
+    }
+
+    switch(KREG_LoadSnapshot(snapshotFileName))
+    {
+        case KREG_OK:
+            fprintf(stdout, "* KVP Registry has been loaded from snapshot %s\n", snapshotFileName);
+            break;
+
+        case KREG_ERR_SNAP_INVALID:
+            fprintf(stderr, "Invalid snapshot %s\n", snapshotFileName);
+            exit(EXIT_FAILURE);
+            break;
+
+        default:
+            fprintf(stderr, "Can't open %s\n", snapshotFileName);
+            exit(EXIT_FAILURE);
+            break;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Writes the loaded registry into the snapshot file (if it is enabled)
+ *
+ * A failed write is not fatal, the server starts from the registry file next time.
+ *
+ * @return none
+ */
+static void writeSnapshot( void )
+{
+    if (snapshotFileName == NULL)
+    {
+        return;
+    }
+
+    if (KREG_WriteSnapshot(snapshotFileName) == KREG_OK)
+    {
+        fprintf(stdout, "* Snapshot has been written to %s\n", snapshotFileName);
+    }
+    else
+    {
+        perror("write snapshot");
+    }
+}
+
+/**
+ * @brief Restores a PUT from the write-ahead log
+ *
+ * @param[in] key
+ * @param[in] keyLen
+ * @param[in] value
+ * @param[in] valLen
+ * @return none
+ */
+static void replayRecord( const char* key, uint8_t keyLen, const char* value, uint8_t valLen )
+{
+    KREG_StrView keyView = { key, keyLen };
+    KREG_StrView valView = { value, valLen };
+
+    KREG_StoreKeyValue(&keyView, &valView);
+}
+
+/**
+ * @brief Appends a stored PUT to the write-ahead log
+ *
+ * Called by the registry while the shard of the key is locked, so the
+ * PUTs of a key are logged in the order they are applied, while PUTs
+ * of other shards are logged in parallel.
+ *
+ * @param[in] key
+ * @param[in] keyLen
+ * @param[in] value
+ * @param[in] valLen
+ * @return none
+ */
+static void logRecord( const char* key, uint8_t keyLen, const char* value, uint8_t valLen )
+{
+    if (WAL_Append(key, keyLen, value, valLen) != WAL_OK)
+    {
+        perror("append log");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Replays and opens the write-ahead log (if it is enabled)
+ *
+ * If the server stopped during a log compaction, the rotated log is
+ * replayed before the current one, then both of them are merged into a
+ * new snapshot before the server starts. Replaying records which are
+ * already in the snapshot is harmless, it yields the same registry.
+ * In case of any error, the program terminates.
+ *
+ * @return none
+ */
+static void openLog( void )
+{
+    uint32_t nrOfRecords;
+    uint32_t nrOfCompactRecords = 0;
+    _Bool unfinishedCompaction;
+
+    if (logFileName == NULL)
+    {
+        return;
+    }
+
+    unfinishedCompaction = (access(compactLogFileName, F_OK) == 0);
+
+    if ((unfinishedCompaction && (WAL_Replay(compactLogFileName, replayRecord, &nrOfCompactRecords) != WAL_OK))
+     || (WAL_Replay(logFileName, replayRecord, &nrOfRecords) != WAL_OK))
+    {
+        perror("replay log");
+        exit(EXIT_FAILURE);
+    }
+    fprintf(stdout, "* %u PUTs have been replayed from %s\n", nrOfCompactRecords + nrOfRecords, logFileName);
+
+    if (unfinishedCompaction && (snapshotFileName != NULL))
+    {
+        if ((KREG_WriteSnapshot(snapshotFileName) != KREG_OK)
+         || (unlink(compactLogFileName) != 0)
+         || (truncate(logFileName, 0) != 0))
+        {
+            perror("compact log");
+            exit(EXIT_FAILURE);
+        }
+        fprintf(stdout, "* Unfinished log compaction has been completed\n");
+    }
+
+    if (WAL_Open(logFileName, logSyncPolicy, logSyncIntervalMs) != WAL_OK)
+    {
+        perror("open log");
+        exit(EXIT_FAILURE);
+    }
+
+    /* the replayed records are not logged again */
+    KREG_SetUpdateHook(logRecord);
+}
+
+/**
+ * @brief Adds a connection to the list of the round (if it is not there yet)
+ *
+ * @param[in] conn client connection
+ * @return none
+ */
+static void addPending( Connection* conn )
+{
+    if (!conn->pending)
+    {
+        conn->pending = true;
+        conn->nextPending = pendingConnections;
+        pendingConnections = conn;
+    }
+}
+
+/**
+ * @brief Appends replies to the send queue of a connection
+ *
+ * The data is copied, so the reply buffer can be reused right away, the
+ * block is freed when it has been sent.
+ *
+ * @param[in] conn client connection
+ * @param[in] data replies
+ * @param[in] len length of the replies
+ * @return none
+ */
+static void appendSendBlock( Connection* conn, const char* data, size_t len )
+{
+    SendBlock* block = (SendBlock*)malloc(sizeof(SendBlock) + len);
+
+    if (block == NULL)
+    {
+        perror("send");
+        removeClient(conn);
+        return;
+    }
+
+    block->next = NULL;
+    block->len = len;
+    block->offset = 0;
+    memcpy(block->data, data, len);
+
+    if (conn->sendHead == NULL)
+    {
+        conn->sendHead = block;
+    }
+    else
+    {
+        conn->sendTail->next = block;
+    }
+    conn->sendTail = block;
+    conn->sendQueued += len;
+}
+
+/**
+ * @brief Gathers the queued replies of a connection into its send message
+ *
+ * @param[in] conn client connection with a non-empty send queue
+ * @return none
+ */
+static void prepareSendMsg( Connection* conn )
+{
+    SendBlock* block = conn->sendHead;
+    size_t nrOfIovs = 0;
+
+    while ((block != NULL) && (nrOfIovs < SEND_IOV_MAX))
+    {
+        conn->sendIov[nrOfIovs].iov_base = block->data + block->offset;
+        conn->sendIov[nrOfIovs].iov_len = block->len - block->offset;
+        nrOfIovs++;
+        block = block->next;
+    }
+
+    memset(&conn->sendMsg, 0, sizeof(conn->sendMsg));
+    conn->sendMsg.msg_iov = conn->sendIov;
+    conn->sendMsg.msg_iovlen = nrOfIovs;
+}
+
+/**
+ * @brief Removes the sent bytes from the send queue of a connection
+ *
+ * @param[in] conn client connection
+ * @param[in] len number of bytes sent
+ * @return none
+ */
+static void consumeSent( Connection* conn, size_t len )
+{
+    SendBlock* block;
+
+    STATS_Add(STATS_BYTES_OUT, len);
+    conn->sendQueued -= len;
+
+    while (len > 0)
+    {
+        block = conn->sendHead;
+
+        if (len < block->len - block->offset)
+        {
+            block->offset += len;
+            return;
+        }
+
+        len -= block->len - block->offset;
+        conn->sendHead = block->next;
+        free(block);
+    }
+}
+
+/**
+ * @brief Drops the send queue of a broken connection
+ *
+ * @param[in] conn client connection
+ * @return none
+ */
+static void dropSends( Connection* conn )
+{
+    SendBlock* block;
+
+    while ((block = conn->sendHead) != NULL)
+    {
+        conn->sendHead = block->next;
+        free(block);
+    }
+    conn->sendQueued = 0;
+}
+
+/**
+ * @brief Takes a connection buffer (CONN_BUF_SIZE) from the pool of the worker
+ *
+ * @return buffer, NULL if out of memory
+ */
+static char* getBuffer( void )
+{
+    void* buf = freeBuffers;
+
+    if (buf == NULL)
+    {
+        return (char*)malloc(CONN_BUF_SIZE);
+    }
+
+    freeBuffers = *(void**)buf;
+    nrOfFreeBuffers--;
+
+    return (char*)buf;
+}
+
+/**
+ * @brief Returns a connection buffer to the pool of the worker
+ *
+ * The pool keeps at most CONN_BUF_POOL_MAX buffers, the rest is freed.
+ *
+ * @param[in] buf buffer (NULL is ignored)
+ * @return none
+ */
+static void putBuffer( char* buf )
+{
+    if (buf == NULL)
+    {
+        return;
+    }
+
+    if (nrOfFreeBuffers >= CONN_BUF_POOL_MAX)
+    {
+        free(buf);
+        return;
+    }
+
+    *(void**)buf = freeBuffers;
+    freeBuffers = buf;
+    nrOfFreeBuffers++;
+}
+
+/**
+ * @brief Makes sure a connection has an input buffer before data is received
+ *
+ * A connection which runs out of memory is closed.
+ *
+ * @param[in] conn client connection
+ * @return true if the connection has an input buffer
+ */
+static _Bool reserveInput( Connection* conn )
+{
+    if ((conn->input == NULL) && ((conn->input = getBuffer()) == NULL))
+    {
+        perror("input");
+        removeClient(conn);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Returns the input buffer of a connection which has no incomplete request
+ *
+ * An idle connection doesn't hold an input buffer.
+ *
+ * @param[in] conn client connection
+ * @return none
+ */
+static void releaseInput( Connection* conn )
+{
+    if (conn->inputLen == 0)
+    {
+        putBuffer(conn->input);
+        conn->input = NULL;
+    }
+}
+
+/**
+ * @brief Closes a connection after 'bye' when its replies have been sent
+ *
+ * @param[in] conn client connection
+ * @return none
+ */
+static void closeIfFlushed( Connection* conn )
+{
+    if (conn->closing && !conn->closed && (conn->sendHead == NULL) && (conn->replyLen == 0))
+    {
+        removeClient(conn);
+    }
+}
+
+/**
+ * @brief Sends a reply to a client
+ *
+ * The reply is deferred till the end of the event loop round, so the
+ * replies of the pipelined requests of a client are sent together, and
+ * only after the PUTs of the round are committed to the log. If the
+ * replies of the client don't fit in its buffer, the round is committed
+ * early; if that closes the connection, the reply is dropped and the
+ * caller stops at conn->closed.
+ *
+ * @param[in] conn client connection
+ * @param[in] data reply
+ * @param[in] len length of the reply
+ * @return none
+ */
+static void sendReplyData( Connection* conn, const void* data, size_t len )
+{
+    if (conn->replyLen + len > CONN_BUF_SIZE)
+    {
+        commitRound(false);
+        if (conn->closed)
+        {
+            return;
+        }
+    }
+
+    if ((conn->reply == NULL) && ((conn->reply = getBuffer()) == NULL))
+    {
+        perror("reply");
+        removeClient(conn);
+        return;
+    }
+
+    memcpy(conn->reply + conn->replyLen, data, len);
+    conn->replyLen += len;
+
+    addPending(conn);
+}
+
+/**
+ * @brief Sends a text reply to a client (see sendReplyData())
+ *
+ * @param[in] conn client connection
+ * @param[in] reply zero terminated reply
+ * @return none
+ */
+static void sendReply( Connection* conn, const char* reply )
+{
+    sendReplyData(conn, reply, strlen(reply));
+}
+
+/**
+ * @brief Commits the log and sends the deferred replies of the round
+ *
+ * Only the connections which got a reply or have been closed in this
+ * round are visited. The closed ones are released only at the end of the
+ * round: an early commit runs in the middle of a request, so it keeps
+ * them in the list and never frees a connection under its caller. A
+ * connection closed while its replies are sent is released by the next
+ * round.
+ * With epoll, the replies are sent at once as far as the socket takes
+ * them, the rest is queued till it becomes writable. With io_uring, the
+ * replies are queued as send requests, which are submitted by the next
+ * wait for completions. A client whose send queue reaches
+ * SEND_QUEUE_LIMIT is not read till the queue drains. A client which
+ * sent 'bye' is closed when its queue is empty (see closeIfFlushed()).
+ * In case of a log write error, the program terminates without sending
+ * the replies, so no client gets an acknowledgement of a lost PUT.
+ *
+ * @param[in] endOfRound false: early commit of a full reply buffer
+ * @return none
+ */
+static void commitRound( _Bool endOfRound )
+{
+    Connection* conn;
+    Connection* connections = pendingConnections;
+
+    if ((logFileName != NULL) && (WAL_Commit() != WAL_OK))
+    {
+        perror("commit log");
+        exit(EXIT_FAILURE);
+    }
+
+    pendingConnections = NULL;
+
+    while ((conn = connections) != NULL)
+    {
+        connections = conn->nextPending;
+
+        conn->pending = false;
+
+        if (conn->closed)
+        {
+            if (endOfRound)
+            {
+                releaseConnection(conn);
+            }
+            else
+            {
+                addPending(conn);
+            }
+            continue;
+        }
+
+        /* a connection closing on 'bye' may have no reply in this round */
+        if (conn->replyLen > 0)
+        {
+            if (useUring)
+            {
+                _Bool idle = (conn->sendHead == NULL);
+
+                appendSendBlock(conn, conn->reply, conn->replyLen);
+                if (idle && (conn->sendHead != NULL))
+                {
+                    queueSend(conn);
+                }
+                if ((conn->sendQueued >= SEND_QUEUE_LIMIT) && !conn->readPaused)
+                {
+                    conn->readPaused = true;
+                    cancelRecv(conn);
+                }
+            }
+            else
+            {
+                sendReplies(conn);
+            }
+            conn->replyLen = 0;
+        }
+
+        /* the rest of the replies has been copied to the send queue */
+        putBuffer(conn->reply);
+        conn->reply = NULL;
+
+        closeIfFlushed(conn);
+    }
+}
+
+/**
+ * @brief Starts writing the snapshot in the background
+ *
+ * The process forks and the child writes the snapshot of the registry
+ * from its copy-on-write image, while the parent keeps serving the clients.
+ * If the log is enabled, it is rotated right before the fork. A PUT is
+ * logged after it has been applied, so every record of the rotated log
+ * is in the snapshot of the child (a PUT logged after the rotation may be
+ * in both, replaying it is harmless). The rotated log is removed when the
+ * snapshot has been written (see finishSnapshot()).
+ * The caller must hold the snapshot lock.
+ *
+ * @return BGSAVE_OK
+ *         BGSAVE_ERR_BUSY (a snapshot is already being written)
+ *         BGSAVE_ERR_FORK (or the snapshot is not enabled)
+ */
+static uint8_t startSnapshot( void )
+{
+    uint8_t retVal;
+
+    /* the rotated log of a failed compaction must not be overwritten */
+    if ((snapshotFileName == NULL) || compactionFailed)
+    {
+        return BGSAVE_ERR_FORK;
+    }
+
+    if (BGSAVE_InProgress())
+    {
+        return BGSAVE_ERR_BUSY;
+    }
+
+    if ((logFileName != NULL) && (WAL_Rotate(compactLogFileName) != WAL_OK))
+    {
+        perror("rotate log");
+        exit(EXIT_FAILURE);
+    }
+
+    if ((retVal = BGSAVE_Start(snapshotFileName)) != BGSAVE_OK)
+    {
+        perror("fork");
+
+        /* the rotated log is kept, the next start of the server compacts it */
+        compactionFailed = (logFileName != NULL);
+    }
+
+    return retVal;
+}
+
+/**
+ * @brief Checks whether the background snapshot has finished
+ *
+ * Reports the time of the snapshot and the memory which has been copied
+ * on write, because the parent modified it while the child was running.
+ * If the snapshot failed, the rotated log is kept and no more snapshot
+ * is written in the background, the next start of the server completes it.
+ *
+ * @return none
+ */
+static void finishSnapshot( void )
+{
+    BGSAVE_Result result;
+
+    if (!BGSAVE_Poll(&result))
+    {
+        return;
+    }
+
+    if ((result.status == KREG_OK)
+     && ((logFileName == NULL) || (unlink(compactLogFileName) == 0)))
+    {
+        fprintf(stdout, "* Snapshot has been written in %llu ms (fork: %llu us, copy-on-write: %llu kB)\n",
+                (unsigned long long int)(result.saveUs / 1000u),
+                (unsigned long long int)result.forkUs,
+                (unsigned long long int)(result.cowBytes / 1024u));
+    }
+    else
+    {
+        fprintf(stderr, "Background snapshot failed (%u)\n", result.status);
+        compactionFailed = (logFileName != NULL);
+    }
+}
+
+/**
+ * @brief Compacts the write-ahead log in the background
+ *
+ * When the log grows over the threshold, a new snapshot is started,
+ * so the log is rotated and the rotated part is removed when the
+ * snapshot has been written.
+ *
+ * @return none
+ */
+static void compactLog( void )
+{
+    if ((logFileName == NULL) || BGSAVE_InProgress() || (WAL_Size() < compactionThreshold))
+    {
+        return;
+    }
+
+    /* don't retry in every round if fork() fails */
+    if (startSnapshot() == BGSAVE_ERR_FORK)
+    {
+        compactionFailed = true;
+    }
+}
+
+/**
+ * @brief Finishes the background snapshot and compacts the log (called in each round)
+ *
+ * If an other worker is doing it, the round skips it.
+ *
+ * @return none
+ */
+static void maintainSnapshot( void )
+{
+    if (pthread_mutex_trylock(&snapshotLock) == 0)
+    {
+        finishSnapshot();
+        compactLog();
+        pthread_mutex_unlock(&snapshotLock);
+    }
+}
+
+/**
+ * @brief Creates a socket for accepting client connections
+ *
+ * In case of any error, the program terminates, therefore the return value
+ * is not checked for error outside of this function.
+ *
+ * @return socket descriptor
+ */
+static int createSocket( void )
+{
+    int sock;
+    struct sockaddr_in name;
+
+    /* Create the socket. */
+    sock = socket(PF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
+    {
+        perror("create socket");
+        exit(EXIT_FAILURE);
+    }
+
+    /* the workers bind their own sockets to the same port, the kernel spreads the connections */
+    if ((nrOfWorkers > 1) && (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &(int){ 1 }, sizeof(int)) < 0))
+    {
+        perror("reuse port");
+        exit(EXIT_FAILURE);
+    }
+
+    name.sin_family = AF_INET;
+    name.sin_port = htons(listeningPort);
+    name.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind (sock, (struct sockaddr*) &name, sizeof (name)) < 0)
+    {
+        perror("bind socket");
+        exit(EXIT_FAILURE);
+    }
+    
+    return sock;
+}
+
+/**
+ * @brief Raises the limit of open descriptors to the hard limit
+ *
+ * Each client needs a descriptor, the default soft limit (usually 1024)
+ * would cap the number of connections.
+ *
+ * @return none
+ */
+static void raiseDescriptorLimit( void )
+{
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+/**
+ * @brief Reading data from a client socket
+ *
+ * The socket is edge-triggered, so it is read till it would block,
+ * otherwise no more event would be reported for the pending data.
+ * The socket is closed if the client closed the connection or the
+ * connection is broken.
+ *
+ * @param[in] conn connection to be read from
+ * @return none
+ */
+static void readSocket( Connection* conn )
+{
+    ssize_t nbytes;
+
+    /* nothing is read after 'bye' */
+    while (!conn->closed && !conn->closing)
+    {
+        /* the client doesn't read its replies, its requests wait in the socket */
+        if (conn->sendQueued >= SEND_QUEUE_LIMIT)
+        {
+            conn->readPaused = true;
+            return;
+        }
+        conn->readPaused = false;
+
+        if (!reserveInput(conn))
+        {
+            return;
+        }
+
+        nbytes = recv(conn->sock, conn->input + conn->inputLen, CONN_BUF_SIZE - conn->inputLen, MSG_DONTWAIT);
+        if (nbytes < 0)
+        {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+            {
+                releaseInput(conn);
+                return;
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            /* Read error. */
+            perror("read socket");
+            removeClient(conn);
+        }
+        /* EOF (client closed the connection) */
+        else if (nbytes == 0)
+        {
+            removeClient(conn);
+        }
+        else
+        {
+            /* process the complete client requests */
+            STATS_Add(STATS_BYTES_IN, (uint64_t) nbytes);
+            conn->inputLen += nbytes;
+            processInput(conn);
+        }
+    }
+}
+
+/**
+ * @brief Sends the replies of the round to a client (epoll)
+ *
+ * If nothing is queued, the replies are sent directly from the reply
+ * buffer, only the part the socket doesn't take is queued. Otherwise the
+ * replies are queued behind the earlier ones, which are waiting for the
+ * socket to become writable.
+ *
+ * @param[in] conn client connection
+ * @return none
+ */
+static void sendReplies( Connection* conn )
+{
+    ssize_t nbytes = 0;
+
+    if (conn->sendHead == NULL)
+    {
+        do
+        {
+            nbytes = send(conn->sock, conn->reply, conn->replyLen, MSG_DONTWAIT | MSG_NOSIGNAL);
+        }
+        while ((nbytes < 0) && (errno == EINTR));
+
+        if (nbytes < 0)
+        {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+            {
+                /* broken connection, nothing can be sent any more */
+                removeClient(conn);
+                return;
+            }
+            nbytes = 0;
+        }
+        STATS_Add(STATS_BYTES_OUT, (uint64_t) nbytes);
+    }
+
+    if ((size_t)nbytes < conn->replyLen)
+    {
+        appendSendBlock(conn, conn->reply + nbytes, conn->replyLen - nbytes);
+    }
+}
+
+/**
+ * @brief Sends the queued replies of a client when its socket is writable (epoll)
+ *
+ * The queued blocks are sent by gather writes till the queue is empty
+ * or the socket is full.
+ *
+ * @param[in] conn client connection
+ * @return none
+ */
+static void flushSends( Connection* conn )
+{
+    ssize_t nbytes;
+
+    while (!conn->closed && (conn->sendHead != NULL))
+    {
+        prepareSendMsg(conn);
+
+        nbytes = sendmsg(conn->sock, &conn->sendMsg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (nbytes < 0)
+        {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+            {
+                return;
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            /* broken connection, nothing can be sent any more */
+            removeClient(conn);
+            return;
+        }
+        consumeSent(conn, (size_t)nbytes);
+    }
+
+    closeIfFlushed(conn);
+}
+
+/**
+ * @brief Accepts all pending connections of the listening socket
+ *
+ * @param[in] sock listening socket
+ * @return none
+ */
+static void acceptClients( int sock )
+{
+    int new;
+    struct sockaddr_in clientname;
+    socklen_t size;
+
+    for (;;)
+    {
+        size = sizeof(clientname);
+        new = accept(sock, (struct sockaddr*) &clientname, &size);
+        if (new < 0)
+        {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+            {
+                /* e.g. out of descriptors, the connection stays in the backlog */
+                perror("accept");
+            }
+            if (errno != EINTR)
+            {
+                return;
+            }
+            continue;
+        }
+        addClient(new, &clientname);
+    }
+}
+
+/**
+ * @brief Close client socket and release its connection
+ *
+ * The connection is released at the end of the round.
+ *
+ * @param[in] conn connection to be removed
+ * @return none
+ */
+static void removeClient( Connection* conn )
+{
+    fprintf(stdout, "* Client disconnected from host %s:%d\n", inet_ntoa(conn->addr.sin_addr), ntohs(conn->addr.sin_port));
+
+    /* io_uring requests hold the socket open, shutdown completes them;
+     * with epoll, nothing refers to the queued replies */
+    if (useUring)
+    {
+        shutdown(conn->sock, SHUT_RDWR);
+    }
+    else
+    {
+        dropSends(conn);
+    }
+
+    /* closing the socket removes it from the epoll set */
+    close(conn->sock);
+    conn->closed = true;
+    STATS_Add(STATS_CONNS_CLOSED, 1);
+
+    /* a descriptor is available again */
+    if (acceptPaused)
+    {
+        acceptPaused = false;
+        armAccept();
+    }
+
+    /* the connection may still be used by the caller */
+    addPending(conn);
+}
+
+/**
+ * @brief Add client socket to the epoll set (or start receiving with io_uring)
+ *
+ * @param[in] sock socket to be added
+ * @param[in] client client address information to display
+ * @return none
+ */
+static void addClient( int sock, struct sockaddr_in* client )
+{
+    struct epoll_event event;
+    Connection* conn = (Connection*)malloc(sizeof(Connection));
+
+    if (conn == NULL)
+    {
+        close(sock);
+        return;
+    }
+
+    conn->sock = sock;
+    conn->closed = false;
+    conn->closing = false;
+    conn->pending = false;
+    conn->addr = *client;
+    conn->nextPending = NULL;
+    conn->replyLen = 0;
+    conn->reply = NULL;
+    conn->protocol = CONN_UNDECIDED;
+    conn->inputLen = 0;
+    conn->input = NULL;
+    conn->skipLine = false;
+    conn->readPaused = false;
+    conn->recvArmed = false;
+    conn->cancelArmed = false;
+    conn->sendHead = NULL;
+    conn->sendTail = NULL;
+    conn->sendQueued = 0;
+
+    if (useUring)
+    {
+        armRecv(conn);
+    }
+    else
+    {
+        /* edge-triggered EPOLLOUT is reported only when a full socket gets room */
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = conn;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, sock, &event) < 0)
+        {
+            perror("epoll add client");
+            close(sock);
+            free(conn);
+            return;
+        }
+    }
+
+    STATS_Add(STATS_CONNS_OPENED, 1);
+    fprintf(stdout, "* Client connected from host %s:%d\n", inet_ntoa(client->sin_addr), ntohs(client->sin_port));
+}
+
+/**
+ * @brief Releases a closed connection if no request refers to it any more
+ *
+ * @param[in] conn connection
+ * @return none
+ */
+static void releaseConnection( Connection* conn )
+{
+    if (conn->closed && !conn->pending && !conn->recvArmed && !conn->cancelArmed && (conn->sendHead == NULL))
+    {
+        putBuffer(conn->input);
+        putBuffer(conn->reply);
+        free(conn);
+    }
+}
+
+/**
+ * @brief Returns how long a round may wait for events
+ *
+ * @return timeout in milliseconds (-1: no timeout)
+ */
+static int roundTimeout( void )
+{
+    /* the next sync of the log is due */
+    int timeout = WAL_SyncTimeout();
+
+    /* a connection closed by the last commit is released by the next one */
+    if (pendingConnections != NULL)
+    {
+        return 0;
+    }
+
+    if (BGSAVE_InProgress() && ((timeout < 0) || (timeout > BGSAVE_POLL_MS)))
+    {
+        timeout = BGSAVE_POLL_MS;
+    }
+
+    return timeout;
+}
+
+/**
+ * @brief Event loop of the epoll backend
+ *
+ * The sockets are watched by an edge-triggered epoll set, so the work
+ * of a round depends only on the number of active connections.
+ *
+ * @param[in] sock listening socket
+ * @return none
+ */
+static void serverLoopEpoll( int sock )
+{
+    int nrOfEvents;
+    struct epoll_event event;
+    struct epoll_event events[MAX_EVENTS];
+
+    if ((epollFd = epoll_create1(0)) < 0)
+    {
+        perror("epoll");
+        exit(EXIT_FAILURE);
+    }
+
+    /* the listening socket is the only one without a connection */
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = NULL;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, sock, &event) < 0)
+    {
+        perror("epoll add listener");
+        exit(EXIT_FAILURE);
+    }
+
+    for (;;)
+    {
+        /* Block until input arrives on one or more active sockets */
+        nrOfEvents = epoll_wait(epollFd, events, MAX_EVENTS, roundTimeout());
+        if ((nrOfEvents < 0) && (errno != EINTR))
+        {
+            perror("epoll_wait");
+            exit(EXIT_FAILURE);
+        }
+
+        /* Service the sockets with input pending. */
+        for (int i = 0; i < nrOfEvents; ++i)
+        {
+            Connection* conn = (Connection*)events[i].data.ptr;
+
+            if (conn == NULL)
+            {
+                /* Connection request on original socket. */
+                acceptClients(sock);
+            }
+            else
+            {
+                /* the socket got room for the queued replies */
+                if (events[i].events & EPOLLOUT)
+                {
+                    flushSends(conn);
+                }
+
+                /* Data arriving on an already-connected socket (or hangup),
+                 * or the requests left unread have room for their replies now */
+                if ((events[i].events & ~EPOLLOUT) || conn->readPaused)
+                {
+                    readSocket(conn);
+                }
+            }
+        }
+
+        /* PUTs of this round share one write and fsync of the log */
+        commitRound(true);
+        maintainSnapshot();
+    }
+}
+
+/**
+ * @brief Returns a submission queue entry, the program terminates if there is none
+ *
+ * @return SQE
+ */
+static struct io_uring_sqe* getSqe( void )
+{
+    struct io_uring_sqe* sqe = URING_GetSqe(&ring);
+
+    if (sqe == NULL)
+    {
+        perror("io_uring submit");
+        exit(EXIT_FAILURE);
+    }
+
+    return sqe;
+}
+
+/**
+ * @brief Starts a multishot accept, it completes once for each new connection
+ *
+ * @return none
+ */
+static void armAccept( void )
+{
+    struct io_uring_sqe* sqe = getSqe();
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listeningSock;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = URING_TAG_ACCEPT;
+}
+
+/**
+ * @brief Starts a multishot recv, the kernel picks a provided buffer for each message
+ *
+ * @param[in] conn client connection
+ * @return none
+ */
+static void armRecv( Connection* conn )
+{
+    struct io_uring_sqe* sqe;
+
+    /* the socket number of a closed connection may belong to a new client,
+     * nothing is read after 'bye' */
+    if (conn->closed || conn->closing)
+    {
+        return;
+    }
+
+    sqe = getSqe();
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->sock;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | URING_TAG_RECV;
+    conn->recvArmed = true;
+}
+
+/**
+ * @brief Sends the queued replies of a connection by one gather send
+ *
+ * Only one send is in flight for a connection, so the replies can't be reordered.
+ *
+ * @param[in] conn client connection
+ * @return none
+ */
+static void queueSend( Connection* conn )
+{
+    struct io_uring_sqe* sqe;
+
+    /* the socket number of a closed connection may belong to a new client */
+    if (conn->closed)
+    {
+        return;
+    }
+
+    sqe = getSqe();
+    prepareSendMsg(conn);
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn->sock;
+    sqe->addr = (uint64_t)(uintptr_t)&conn->sendMsg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | URING_TAG_SEND;
+}
+
+/**
+ * @brief Stops the multishot recv of a connection, its send queue is full
+ *
+ * @param[in] conn client connection
+ * @return none
+ */
+static void cancelRecv( Connection* conn )
+{
+    struct io_uring_sqe* sqe;
+
+    if (!conn->recvArmed || conn->cancelArmed || conn->closed)
+    {
+        return;
+    }
+
+    sqe = getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)conn | URING_TAG_RECV;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | URING_TAG_CANCEL;
+    conn->cancelArmed = true;
+}
+
+/**
+ * @brief Processes a completion of the io_uring backend
+ *
+ * @param[in] userData request type and connection
+ * @param[in] res result of the request
+ * @param[in] flags CQE flags
+ * @return none
+ */
+static void handleCompletion( uint64_t userData, int32_t res, uint32_t flags )
+{
+    Connection* conn = (Connection*)(uintptr_t)(userData & ~(uint64_t)URING_TAG_MASK);
+    _Bool more = (flags & IORING_CQE_F_MORE) != 0;
+
+    switch (userData & URING_TAG_MASK)
+    {
+        case URING_TAG_ACCEPT:
+        {
+            struct sockaddr_in clientname;
+            socklen_t size = sizeof(clientname);
+
+            if (res >= 0)
+            {
+                getpeername(res, (struct sockaddr*)&clientname, &size);
+                addClient(res, &clientname);
+            }
+            else if ((res == -EMFILE) || (res == -ENFILE))
+            {
+                /* accepting is continued when a connection is closed */
+                fprintf(stderr, "accept: %s\n", strerror(-res));
+                acceptPaused = !more;
+                return;
+            }
+
+            if (!more)
+            {
+                armAccept();
+            }
+            break;
+        }
+
+        case URING_TAG_RECV:
+        {
+            conn->recvArmed = more;
+
+            if (res > 0)
+            {
+                uint16_t bid = (uint16_t)(flags >> IORING_CQE_BUFFER_SHIFT);
+                const char* data = URING_Buffer(&ring, bid);
+                size_t left = res;
+
+                STATS_Add(STATS_BYTES_IN, (uint64_t) res);
+
+                /* the data is copied into the input of the connection in parts which fit,
+                 * processing the complete requests makes room for the next part */
+                while (!conn->closed && !conn->closing && (left > 0) && reserveInput(conn))
+                {
+                    size_t len = CONN_BUF_SIZE - conn->inputLen;
+
+                    if (len > left)
+                    {
+                        len = left;
+                    }
+                    memcpy(conn->input + conn->inputLen, data, len);
+                    conn->inputLen += len;
+                    data += len;
+                    left -= len;
+                    processInput(conn);
+                }
+                URING_ReturnBuffer(&ring, bid);
+            }
+            else if (!conn->closed && !conn->closing && (res != -ENOBUFS) && (res != -ECANCELED))
+            {
+                /* EOF (client closed the connection) or error, after 'bye' the replies are still sent */
+                removeClient(conn);
+            }
+
+            /* ran out of provided buffers (or completions), they are returned by now;
+             * a recv cancelled for backpressure is restarted when the replies are sent */
+            if (!conn->closed && !conn->recvArmed && !conn->readPaused)
+            {
+                armRecv(conn);
+            }
+            releaseConnection(conn);
+            break;
+        }
+
+        case URING_TAG_SEND:
+        {
+            if ((res < 0) || conn->closed)
+            {
+                /* broken or closed connection, nothing can be sent any more
+                 * (the number of a closed socket may belong to a new client already) */
+                dropSends(conn);
+                if (!conn->closed)
+                {
+                    removeClient(conn);
+                }
+                releaseConnection(conn);
+                break;
+            }
+
+            consumeSent(conn, (size_t)res);
+            if (conn->sendHead != NULL)
+            {
+                queueSend(conn);
+            }
+            closeIfFlushed(conn);
+
+            /* the replies have drained, the requests of the client are read again */
+            if (conn->readPaused && (conn->sendQueued < SEND_QUEUE_LIMIT))
+            {
+                conn->readPaused = false;
+                if (!conn->closed && !conn->recvArmed)
+                {
+                    armRecv(conn);
+                }
+            }
+            releaseConnection(conn);
+            break;
+        }
+
+        case URING_TAG_CANCEL:
+        {
+            /* the recv completes with -ECANCELED (or it has completed already) */
+            conn->cancelArmed = false;
+            releaseConnection(conn);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Creates the io_uring instance and its provided receive buffers
+ *
+ * @return true if the kernel supports every feature of the backend
+ */
+static _Bool startUring( void )
+{
+    if (URING_Init(&ring, URING_ENTRIES) != URING_OK)
+    {
+        return false;
+    }
+
+    if (URING_InitBuffers(&ring, URING_BUF_GROUP, URING_NR_OF_BUFS, CONN_BUF_SIZE) != URING_OK)
+    {
+        URING_Exit(&ring);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Event loop of the io_uring backend
+ *
+ * Connections are accepted by a multishot accept, messages are received
+ * by a multishot recv of each connection into provided buffers, and the
+ * replies of a round are queued as send requests. A round makes one
+ * system call, which submits the sends of the previous round and waits
+ * for the next completions.
+ *
+ * @return none
+ */
+static void serverLoopUring( void )
+{
+    struct io_uring_cqe* cqe;
+    int retVal;
+
+    armAccept();
+
+    for (;;)
+    {
+        retVal = URING_SubmitAndWait(&ring, roundTimeout());
+        if ((retVal < 0) && (retVal != -ETIME) && (retVal != -EINTR))
+        {
+            fprintf(stderr, "io_uring_enter: %s\n", strerror(-retVal));
+            exit(EXIT_FAILURE);
+        }
+
+        /* the CQE is released first, handling it may queue new requests */
+        while ((cqe = URING_PeekCqe(&ring)) != NULL)
+        {
+            uint64_t userData = cqe->user_data;
+            int32_t res = cqe->res;
+            uint32_t flags = cqe->flags;
+
+            URING_SeenCqe(&ring);
+            handleCompletion(userData, res, flags);
+        }
+
+        /* PUTs of this round share one write and fsync of the log */
+        commitRound(true);
+        maintainSnapshot();
+    }
+}
+
+/**
+ * @brief Implements a non-blocking task to accept client connections and read data
+ *
+ * Runs in each worker thread with the worker's own listening socket.
+ *
+ * @param[in] sock listening socket
+ * @return none
+ */
+static void serverTask( int sock )
+{
+    listeningSock = sock;
+    useUring = uringRequested;
+
+    /* without storage, the requests of this worker are not counted */
+    if (STATS_RegisterThread() != STATS_OK)
+    {
+        fprintf(stderr, "Statistics of the worker can't be stored\n");
+    }
+
+    if (useUring && !startUring())
+    {
+        fprintf(stderr, "io_uring can't be started by a worker, it uses epoll\n");
+        useUring = false;
+    }
+
+    if (useUring)
+    {
+        serverLoopUring();
+    }
+    else
+    {
+        serverLoopEpoll(listeningSock);
+    }
+}
+
+/**
+ * @brief Entry point of the worker threads
+ *
+ * @param[in] arg listening socket of the worker
+ * @return never returns
+ */
+static void* workerTask( void* arg )
+{
+    serverTask((int)(intptr_t)arg);
+
+    return NULL;
+}
+
+/**
+ * @brief Creates the listening sockets and starts the workers
+ *
+ * The calling thread becomes the first worker.
+ *
+ * @return none
+ */
+static void startWorkers( void )
+{
+    int socks[MAX_WORKERS];
+
+    raiseDescriptorLimit();
+
+    /* the banner shows the backend the workers run, the kernel is probed once before */
+    if (uringRequested)
+    {
+        if (startUring())
+        {
+            URING_Exit(&ring);
+        }
+        else
+        {
+            fprintf(stderr, "io_uring is not supported by the kernel, epoll is used\n");
+            uringRequested = false;
+        }
+    }
+
+    /* every listener is bound before any worker starts, so no connection is refused */
+    for (uint32_t i = 0; i < nrOfWorkers; i++)
+    {
+        socks[i] = createSocket();
+
+        if ((fcntl(socks[i], F_SETFL, fcntl(socks[i], F_GETFL, 0) | O_NONBLOCK) < 0)
+         || (listen(socks[i], SOMAXCONN) < 0))
+        {
+            perror("listen");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (uint32_t i = 1; i < nrOfWorkers; i++)
+    {
+        pthread_t thread;
+
+        if (pthread_create(&thread, NULL, workerTask, (void*)(intptr_t)socks[i]) != 0)
+        {
+            perror("start worker");
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(thread);
+    }
+
+    /* Server is started and ready to accept connections */
+    fprintf(stdout, "* Server is started and listening on port %d (%u worker(s), %s)\n",
+            listeningPort, nrOfWorkers, uringRequested ? "io_uring" : "epoll");
+
+    serverTask(socks[0]);
+}
+
+int main( int argc, char** argv )
+{
+    processCmdLineOpts(argc, argv);
+
+    /* cold start from the snapshot, the registry file is only an import path */
+    if (!loadSnapshot())
+    {
+        loadRegistryFile();
+        writeSnapshot();
+    }
+
+    /* PUTs of the previous runs */
+    openLog();
+
+    /* start listening, accepting connections and data */
+    startWorkers();
+}
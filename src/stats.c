@@ -0,0 +1,267 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "arena.h"
+#include "histogram.h"
+#include "stats.h"
+
+/**************************************************************/
+/* ------------------- symbolic constants ------------------- */
+/**************************************************************/
+
+#define STATS_CACHE_LINE        64u
+#define STATS_NS_PER_SEC        1000000000ull
+
+/**************************************************************/
+/* ------------------- type declarations -------------------- */
+/**************************************************************/
+
+/**
+ * statistics of a thread, only the owner thread writes it, so the
+ * counters are incremented by a plain load and an atomic store; it
+ * starts on its own cache line and no other data follows it in the line
+ */
+typedef struct StatsThread_TAG
+{
+    uint64_t counters[STATS_NR_OF_COUNTERS];
+    uint64_t errors[STATS_NR_OF_ERRORS];
+    HIST_Histogram latency[STATS_NR_OF_CMDS];   /**< service times in nanoseconds */
+} __attribute__((aligned(STATS_CACHE_LINE))) StatsThread;
+
+/**************************************************************/
+/* ------------------- module local variables --------------- */
+/**************************************************************/
+
+/* storages of the threads, they live till the end of the process */
+static pthread_mutex_t registerLock = PTHREAD_MUTEX_INITIALIZER;
+static ARENA_Arena storage = { NULL, 0, 0 };
+static StatsThread* threads[STATS_MAX_THREADS];
+static uint32_t nrOfThreads = 0;
+
+/* storage of the calling thread (NULL: the thread doesn't count) */
+static __thread StatsThread* ownStats = NULL;
+
+/**************************************************************/
+/* ------------------- function prototypes ------------------ */
+/**************************************************************/
+
+static void addCounter( uint64_t* counter, uint64_t value );
+
+/**************************************************************/
+/* ------------------- local functions ---------------------- */
+/**************************************************************/
+
+/**
+ * @brief Adds a value to a counter of the own thread
+ *
+ * Only the owner writes the counter, the atomic store makes it
+ * readable by STATS_Collect() in other threads.
+ *
+ * @param[in]  counter
+ * @param[in]  value
+ * @return     none
+ */
+static void addCounter( uint64_t* counter, uint64_t value )
+{
+    __atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);
+}
+
+/**************************************************************/
+/* ------------------- module interfaces -------------------- */
+/**************************************************************/
+
+/**
+ * @brief Creates the storage of the calling thread
+ *
+ * The storage is taken from an arena, so the pages of the histograms
+ * are backed by memory only when a value is recorded in them.
+ *
+ * @return     STATS_OK
+ *             STATS_ERR_NO_MEM
+ *             STATS_ERR_TOO_MANY
+ */
+uint8_t STATS_RegisterThread( void )
+{
+    StatsThread* stats;
+    uint8_t retVal = STATS_OK;
+
+    if (ownStats != NULL)
+    {
+        return STATS_OK;
+    }
+
+    pthread_mutex_lock(&registerLock);
+
+    if (nrOfThreads == STATS_MAX_THREADS)
+    {
+        retVal = STATS_ERR_TOO_MANY;
+    }
+    else if ((stats = ARENA_Alloc(&storage, sizeof(StatsThread), STATS_CACHE_LINE)) == NULL)
+    {
+        retVal = STATS_ERR_NO_MEM;
+    }
+    else
+    {
+        /* zero filled histograms are empty except their minimum */
+        for (uint32_t i = 0; i < STATS_NR_OF_CMDS; i++)
+        {
+            stats->latency[i].min = UINT64_MAX;
+        }
+
+        ownStats = stats;
+        threads[nrOfThreads] = stats;
+        __atomic_store_n(&nrOfThreads, nrOfThreads + 1, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&registerLock);
+
+    return retVal;
+}
+
+/**
+ * @brief Adds a value to a counter of the calling thread
+ *
+ * @param[in]  counter STATS_xxx counter
+ * @param[in]  value
+ * @return     none
+ */
+void STATS_Add( uint8_t counter, uint64_t value )
+{
+    if (ownStats != NULL)
+    {
+        addCounter(&ownStats->counters[counter], value);
+    }
+}
+
+/**
+ * @brief Counts a failed request of the calling thread
+ *
+ * @param[in]  kregErr error code of the key registry
+ * @return     none
+ */
+void STATS_CountError( uint8_t kregErr )
+{
+    if ((ownStats != NULL) && (kregErr < STATS_NR_OF_ERRORS))
+    {
+        addCounter(&ownStats->errors[kregErr], 1);
+    }
+}
+
+/**
+ * @brief Returns the start time of a command
+ *
+ * @return     monotonic time in nanoseconds
+ */
+uint64_t STATS_Now( void )
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * STATS_NS_PER_SEC + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * @brief Records the service time of commands processed together
+ *
+ * @param[in]  cmd STATS_CMD_xxx
+ * @param[in]  start time returned by STATS_Now() before the commands
+ * @param[in]  count number of commands
+ * @return     none
+ */
+void STATS_RecordCommands( uint8_t cmd, uint64_t start, uint32_t count )
+{
+    if ((ownStats != NULL) && (count != 0))
+    {
+        HIST_RecordCount(&ownStats->latency[cmd], (STATS_Now() - start) / count, count);
+    }
+}
+
+/**
+ * @brief Records the service time of a command
+ *
+ * @param[in]  cmd STATS_CMD_xxx
+ * @param[in]  start time returned by STATS_Now() before the command
+ * @return     none
+ */
+void STATS_RecordCommand( uint8_t cmd, uint64_t start )
+{
+    if (ownStats != NULL)
+    {
+        HIST_Record(&ownStats->latency[cmd], STATS_Now() - start);
+    }
+}
+
+/**
+ * @brief Sums the statistics of every thread
+ *
+ * The threads are not stopped, so the totals are not an exact snapshot,
+ * but every counter is read atomically.
+ *
+ * @param[out] totals
+ * @return     STATS_OK
+ *             STATS_ERR_NO_MEM
+ */
+uint8_t STATS_Collect( STATS_Totals* totals )
+{
+    uint32_t count = __atomic_load_n(&nrOfThreads, __ATOMIC_ACQUIRE);
+    HIST_Histogram* merged = malloc(sizeof(HIST_Histogram));
+
+    if (merged == NULL)
+    {
+        return STATS_ERR_NO_MEM;
+    }
+
+    memset(totals, 0, sizeof(*totals));
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        for (uint32_t j = 0; j < STATS_NR_OF_COUNTERS; j++)
+        {
+            totals->counters[j] += __atomic_load_n(&threads[i]->counters[j], __ATOMIC_RELAXED);
+        }
+        for (uint32_t j = 0; j < STATS_NR_OF_ERRORS; j++)
+        {
+            totals->errors[j] += __atomic_load_n(&threads[i]->errors[j], __ATOMIC_RELAXED);
+        }
+    }
+
+    for (uint32_t cmd = 0; cmd < STATS_NR_OF_CMDS; cmd++)
+    {
+        STATS_Latency* latency = &totals->commands[cmd];
+
+        HIST_Reset(merged);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            HIST_Merge(merged, &threads[i]->latency[cmd]);
+        }
+
+        latency->count = merged->totalCount;
+        latency->p50 = HIST_ValueAtPercentile(merged, 50.0);
+        latency->p99 = HIST_ValueAtPercentile(merged, 99.0);
+        latency->p999 = HIST_ValueAtPercentile(merged, 99.9);
+        latency->max = merged->max;
+    }
+
+    free(merged);
+
+    return STATS_OK;
+}
@@ -0,0 +1,113 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdint.h>
+
+/** Return values of this module */
+#define STATS_OK                0u
+#define STATS_ERR_NO_MEM        1u
+#define STATS_ERR_TOO_MANY      2u
+
+/** counters */
+#define STATS_GET_HITS          0u
+#define STATS_GET_MISSES        1u
+#define STATS_PUTS              2u
+#define STATS_BAD_REQUESTS      3u      /**< unknown commands, too long or malformed requests */
+#define STATS_BYTES_IN          4u
+#define STATS_BYTES_OUT         5u
+#define STATS_CONNS_OPENED      6u
+#define STATS_CONNS_CLOSED      7u
+#define STATS_NR_OF_COUNTERS    8u
+
+/** failed requests are counted by the error code of the key registry (KREG_xxx) */
+#define STATS_NR_OF_ERRORS      16u
+
+/** commands with a service time histogram */
+#define STATS_CMD_GET           0u
+#define STATS_CMD_PUT           1u
+#define STATS_CMD_MGET          2u
+#define STATS_CMD_MPUT          3u
+#define STATS_CMD_SAVE          4u
+#define STATS_CMD_STATS         5u
+#define STATS_NR_OF_CMDS        6u
+
+/** maximum number of threads which can count */
+#define STATS_MAX_THREADS       512u
+
+/*
+ * Every thread counts into its own storage (aligned to cache lines, so
+ * the threads never write the same line), without atomic read-modify-write
+ * or locks. STATS_Collect() sums the storages of every thread.
+ */
+
+/**
+ * Service time percentiles of a command (in nanoseconds)
+ */
+typedef struct STATS_Latency_TAG
+{
+    uint64_t count;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+} STATS_Latency;
+
+/**
+ * Sum of the statistics of every thread
+ */
+typedef struct STATS_Totals_TAG
+{
+    uint64_t counters[STATS_NR_OF_COUNTERS];    /**< indexed by STATS_xxx counters */
+    uint64_t errors[STATS_NR_OF_ERRORS];        /**< indexed by KREG_xxx codes */
+    STATS_Latency commands[STATS_NR_OF_CMDS];   /**< indexed by STATS_CMD_xxx */
+} STATS_Totals;
+
+/**
+ * Creates the storage of the calling thread, the calls of a thread
+ * without storage are ignored
+ *
+ * return values:
+ *  STATS_OK
+ *  STATS_ERR_NO_MEM
+ *  STATS_ERR_TOO_MANY (more than STATS_MAX_THREADS threads)
+ */
+uint8_t STATS_RegisterThread( void );
+
+/**
+ * Adds 'value' to a counter of the calling thread
+ */
+void STATS_Add( uint8_t counter, uint64_t value );
+
+/**
+ * Counts a request failed with a key registry error (KREG_xxx)
+ */
+void STATS_CountError( uint8_t kregErr );
+
+/**
+ * return values:
+ *  the start time of a command for STATS_RecordCommand()
+ */
+uint64_t STATS_Now( void );
+
+/**
+ * Records the service time of 'count' commands processed together since 'start'
+ * (each of them gets an equal share)
+ */
+void STATS_RecordCommands( uint8_t cmd, uint64_t start, uint32_t count );
+
+/**
+ * Records the service time of a command since 'start'
+ */
+void STATS_RecordCommand( uint8_t cmd, uint64_t start );
+
+/**
+ * Sums the statistics of every thread, it can be called by any thread
+ * while the others are counting
+ *
+ * return values:
+ *  STATS_OK
+ *  STATS_ERR_NO_MEM
+ */
+uint8_t STATS_Collect( STATS_Totals* totals );
+
+#endif /* _STATS_H_ */
@@ -0,0 +1,396 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+
+/**************************************************************/
+/* ------------------- symbolic constants ------------------- */
+/**************************************************************/
+
+/* completions of multishot requests outnumber the submissions */
+#define URING_CQ_FACTOR     8u
+
+/* size of the probe, every opcode fits in it */
+#define URING_PROBE_OPS     256u
+
+/**************************************************************/
+/* ------------------- function prototypes ------------------ */
+/**************************************************************/
+
+static int sysSetup( uint32_t entries, struct io_uring_params* params );
+static int sysEnter( int fd, uint32_t toSubmit, uint32_t minComplete, uint32_t flags, void* arg, size_t argSize );
+static int sysRegister( int fd, uint32_t opcode, void* arg, uint32_t nrOfArgs );
+static _Bool opSupported( int fd, const uint8_t* opcodes, size_t nrOfOpcodes );
+static uint32_t publishSqes( URING_Ring* ring );
+
+/**************************************************************/
+/* ------------------- local functions ---------------------- */
+/**************************************************************/
+
+/**
+ * @brief io_uring_setup(2), there is no libc wrapper
+ */
+static int sysSetup( uint32_t entries, struct io_uring_params* params )
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+/**
+ * @brief io_uring_enter(2), there is no libc wrapper
+ */
+static int sysEnter( int fd, uint32_t toSubmit, uint32_t minComplete, uint32_t flags, void* arg, size_t argSize )
+{
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+/**
+ * @brief io_uring_register(2), there is no libc wrapper
+ */
+static int sysRegister( int fd, uint32_t opcode, void* arg, uint32_t nrOfArgs )
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nrOfArgs);
+}
+
+/**
+ * @brief Checks whether the kernel supports the given operations
+ *
+ * @param[in]  fd io_uring descriptor
+ * @param[in]  opcodes
+ * @param[in]  nrOfOpcodes
+ * @return     true if every operation is supported
+ */
+static _Bool opSupported( int fd, const uint8_t* opcodes, size_t nrOfOpcodes )
+{
+    size_t size = sizeof(struct io_uring_probe) + URING_PROBE_OPS * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = (struct io_uring_probe*)calloc(1, size);
+    _Bool supported = (probe != NULL) && (sysRegister(fd, IORING_REGISTER_PROBE, probe, URING_PROBE_OPS) == 0);
+
+    for (size_t i = 0; supported && (i < nrOfOpcodes); i++)
+    {
+        supported = (opcodes[i] <= probe->last_op)
+                 && ((probe->ops[opcodes[i]].flags & IO_URING_OP_SUPPORTED) != 0);
+    }
+
+    free(probe);
+
+    return supported;
+}
+
+/**
+ * @brief Makes the queued SQEs visible to the kernel
+ *
+ * @param[in]  ring
+ * @return     number of SQEs not consumed by the kernel yet
+ */
+static uint32_t publishSqes( URING_Ring* ring )
+{
+    /* the SQEs must be written before the kernel can see the new tail */
+    __atomic_store_n(ring->sqTail, ring->sqLocalTail, __ATOMIC_RELEASE);
+
+    return ring->sqLocalTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+}
+
+/**************************************************************/
+/* ------------------- module interfaces -------------------- */
+/**************************************************************/
+
+/**
+ * @brief Creates the rings
+ *
+ * The submission and completion queues are mapped as one region
+ * (IORING_FEAT_SINGLE_MMAP), and waiting with a timeout needs
+ * IORING_FEAT_EXT_ARG. Every opcode the server submits is probed.
+ * IORING_OP_SEND_ZC is never submitted: multishot recv has been added
+ * in the same kernel release (6.0), so it stands in to detect that.
+ *
+ * @param[out] ring
+ * @param[in]  entries size of the submission queue (power of 2)
+ * @return     URING_OK
+ *             URING_ERR_SETUP
+ *             URING_ERR_NOT_SUPPORTED
+ */
+uint8_t URING_Init( URING_Ring* ring, uint32_t entries )
+{
+    static const uint8_t requiredOps[] = { IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG,
+                                           IORING_OP_ASYNC_CANCEL, IORING_OP_SEND_ZC };
+    struct io_uring_params params;
+    size_t sqSize;
+    size_t cqSize;
+    uint8_t* mem;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * URING_CQ_FACTOR;
+
+    if ((ring->fd = sysSetup(entries, &params)) < 0)
+    {
+        return URING_ERR_SETUP;
+    }
+
+    if (((params.features & IORING_FEAT_SINGLE_MMAP) == 0)
+     || ((params.features & IORING_FEAT_EXT_ARG) == 0)
+     || !opSupported(ring->fd, requiredOps, sizeof(requiredOps)))
+    {
+        close(ring->fd);
+        return URING_ERR_NOT_SUPPORTED;
+    }
+
+    sqSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ringMemSize = (sqSize > cqSize) ? sqSize : cqSize;
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring->ringMem = mmap(NULL, ring->ringMemSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if ((ring->ringMem == MAP_FAILED) || (ring->sqes == MAP_FAILED))
+    {
+        if (ring->ringMem != MAP_FAILED)
+        {
+            munmap(ring->ringMem, ring->ringMemSize);
+        }
+        if (ring->sqes != MAP_FAILED)
+        {
+            munmap(ring->sqes, ring->sqesSize);
+        }
+        close(ring->fd);
+        return URING_ERR_SETUP;
+    }
+
+    mem = (uint8_t*)ring->ringMem;
+    ring->sqHead = (uint32_t*)(mem + params.sq_off.head);
+    ring->sqTail = (uint32_t*)(mem + params.sq_off.tail);
+    ring->sqArray = (uint32_t*)(mem + params.sq_off.array);
+    ring->sqMask = *(uint32_t*)(mem + params.sq_off.ring_mask);
+    ring->sqLocalTail = *ring->sqTail;
+    ring->cqHead = (uint32_t*)(mem + params.cq_off.head);
+    ring->cqTail = (uint32_t*)(mem + params.cq_off.tail);
+    ring->cqMask = *(uint32_t*)(mem + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(mem + params.cq_off.cqes);
+
+    /* SQEs are used in ring order, so the indirection array is fixed */
+    for (uint32_t i = 0; i <= ring->sqMask; i++)
+    {
+        ring->sqArray[i] = i;
+    }
+
+    return URING_OK;
+}
+
+/**
+ * @brief Registers a ring of provided buffers
+ *
+ * Receive requests with IOSQE_BUFFER_SELECT take a buffer from the ring
+ * when data arrives, so idle connections don't hold any buffer.
+ *
+ * @param[in]  ring
+ * @param[in]  group buffer group id
+ * @param[in]  nrOfBufs number of buffers (power of 2)
+ * @param[in]  bufSize size of each buffer
+ * @return     URING_OK
+ *             URING_ERR_NO_MEM
+ *             URING_ERR_NOT_SUPPORTED
+ */
+uint8_t URING_InitBuffers( URING_Ring* ring, uint16_t group, uint16_t nrOfBufs, size_t bufSize )
+{
+    struct io_uring_buf_reg reg;
+    size_t ringSize = nrOfBufs * sizeof(struct io_uring_buf);
+
+    ring->bufRing = (struct io_uring_buf_ring*)mmap(NULL, ringSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->bufRing == MAP_FAILED)
+    {
+        ring->bufRing = NULL;
+        return URING_ERR_NO_MEM;
+    }
+
+    if ((ring->bufMem = (char*)malloc(nrOfBufs * bufSize)) == NULL)
+    {
+        munmap(ring->bufRing, ringSize);
+        ring->bufRing = NULL;
+        return URING_ERR_NO_MEM;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->bufRing;
+    reg.ring_entries = nrOfBufs;
+    reg.bgid = group;
+
+    if (sysRegister(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+    {
+        free(ring->bufMem);
+        munmap(ring->bufRing, ringSize);
+        ring->bufRing = NULL;
+        return URING_ERR_NOT_SUPPORTED;
+    }
+
+    ring->bufSize = bufSize;
+    ring->bufMask = nrOfBufs - 1;
+    ring->bufGroup = group;
+
+    for (uint16_t bid = 0; bid < nrOfBufs; bid++)
+    {
+        URING_ReturnBuffer(ring, bid);
+    }
+
+    return URING_OK;
+}
+
+/**
+ * @brief Returns the next free submission queue entry
+ *
+ * @param[in]  ring
+ * @return     zero filled SQE or NULL
+ */
+struct io_uring_sqe* URING_GetSqe( URING_Ring* ring )
+{
+    struct io_uring_sqe* sqe;
+
+    if (ring->sqLocalTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) > ring->sqMask)
+    {
+        /* the queue is full, submit it without waiting */
+        if ((sysEnter(ring->fd, publishSqes(ring), 0, 0, NULL, 0) < 0)
+         || (ring->sqLocalTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) > ring->sqMask))
+        {
+            return NULL;
+        }
+    }
+
+    sqe = &ring->sqes[ring->sqLocalTail & ring->sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sqLocalTail++;
+
+    return sqe;
+}
+
+/**
+ * @brief Submits the queued entries and waits for a completion
+ *
+ * @param[in]  ring
+ * @param[in]  timeoutMs maximum wait (negative: no timeout)
+ * @return     0 or -errno
+ */
+int URING_SubmitAndWait( URING_Ring* ring, int timeoutMs )
+{
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+
+    memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+
+    if (timeoutMs >= 0)
+    {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+
+    if (sysEnter(ring->fd, publishSqes(ring), 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg)) < 0)
+    {
+        return -errno;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Returns the oldest unseen completion
+ *
+ * @param[in]  ring
+ * @return     CQE or NULL
+ */
+struct io_uring_cqe* URING_PeekCqe( URING_Ring* ring )
+{
+    uint32_t head = *ring->cqHead;
+
+    if (head == __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE))
+    {
+        return NULL;
+    }
+
+    return &ring->cqes[head & ring->cqMask];
+}
+
+/**
+ * @brief Releases the oldest completion, its slot can be reused by the kernel
+ *
+ * @param[in]  ring
+ * @return     none
+ */
+void URING_SeenCqe( URING_Ring* ring )
+{
+    __atomic_store_n(ring->cqHead, *ring->cqHead + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Returns a provided buffer
+ *
+ * @param[in]  ring
+ * @param[in]  bid buffer id from the flags of the CQE
+ * @return     buffer
+ */
+char* URING_Buffer( URING_Ring* ring, uint16_t bid )
+{
+    return ring->bufMem + (size_t)bid * ring->bufSize;
+}
+
+/**
+ * @brief Gives a provided buffer back to the kernel
+ *
+ * @param[in]  ring
+ * @param[in]  bid buffer id
+ * @return     none
+ */
+void URING_ReturnBuffer( URING_Ring* ring, uint16_t bid )
+{
+    uint16_t tail = ring->bufRing->tail;
+    struct io_uring_buf* buf = &ring->bufRing->bufs[tail & ring->bufMask];
+
+    buf->addr = (uint64_t)(uintptr_t)URING_Buffer(ring, bid);
+    buf->len = (uint32_t)ring->bufSize;
+    buf->bid = bid;
+
+    /* the entry must be written before the kernel can see the new tail */
+    __atomic_store_n(&ring->bufRing->tail, (uint16_t)(tail + 1), __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Destroys the rings
+ *
+ * @param[in]  ring
+ * @return     none
+ */
+void URING_Exit( URING_Ring* ring )
+{
+    if (ring->bufRing != NULL)
+    {
+        munmap(ring->bufRing, (ring->bufMask + 1u) * sizeof(struct io_uring_buf));
+        free(ring->bufMem);
+        ring->bufRing = NULL;
+    }
+
+    munmap(ring->sqes, ring->sqesSize);
+    munmap(ring->ringMem, ring->ringMemSize);
+    close(ring->fd);
+}
@@ -0,0 +1,113 @@
+#ifndef _URING_H_
+#define _URING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+/** Return values of this module */
+#define URING_OK                    0u
+#define URING_ERR_SETUP             1u
+#define URING_ERR_NOT_SUPPORTED     2u
+#define URING_ERR_NO_MEM            3u
+
+/**
+ * Minimal io_uring instance driven by raw system calls: submission and
+ * completion queues shared with the kernel and an optional ring of
+ * provided buffers the kernel picks the receive buffers from.
+ */
+typedef struct URING_Ring_TAG
+{
+    int fd;                             /**< io_uring descriptor */
+
+    uint32_t* sqHead;                   /**< shared submission queue */
+    uint32_t* sqTail;
+    uint32_t* sqArray;
+    uint32_t sqMask;
+    uint32_t sqLocalTail;               /**< SQEs queued but not yet published */
+    struct io_uring_sqe* sqes;
+
+    uint32_t* cqHead;                   /**< shared completion queue */
+    uint32_t* cqTail;
+    uint32_t cqMask;
+    struct io_uring_cqe* cqes;
+
+    void* ringMem;                      /**< mmapped queues */
+    size_t ringMemSize;
+    size_t sqesSize;
+
+    struct io_uring_buf_ring* bufRing;  /**< provided buffers (NULL if none) */
+    char* bufMem;
+    size_t bufSize;
+    uint16_t bufMask;
+    uint16_t bufGroup;
+} URING_Ring;
+
+/**
+ * Creates the rings, the kernel must support multishot accept and recv
+ *
+ * return values:
+ *  URING_OK
+ *  URING_ERR_SETUP (io_uring is not available, e.g. disabled)
+ *  URING_ERR_NOT_SUPPORTED (the kernel is too old)
+ */
+uint8_t URING_Init( URING_Ring* ring, uint32_t entries );
+
+/**
+ * Registers a ring of 'nrOfBufs' (power of 2) buffers of 'bufSize' bytes
+ * as buffer group 'group'
+ *
+ * return values:
+ *  URING_OK
+ *  URING_ERR_NO_MEM
+ *  URING_ERR_NOT_SUPPORTED
+ */
+uint8_t URING_InitBuffers( URING_Ring* ring, uint16_t group, uint16_t nrOfBufs, size_t bufSize );
+
+/**
+ * return values:
+ *  zero filled submission queue entry, it is submitted by the next
+ *  URING_SubmitAndWait() (or earlier if the queue is full)
+ *  NULL if the queue is full and it can't be submitted
+ */
+struct io_uring_sqe* URING_GetSqe( URING_Ring* ring );
+
+/**
+ * Submits the queued entries and waits for at least one completion
+ * (timeoutMs < 0: no timeout), all in one system call
+ *
+ * return values:
+ *  0 or -errno (-ETIME if the timeout has expired)
+ */
+int URING_SubmitAndWait( URING_Ring* ring, int timeoutMs );
+
+/**
+ * return values:
+ *  the oldest unseen completion, it must be released by URING_SeenCqe()
+ *  NULL if there is no completion
+ */
+struct io_uring_cqe* URING_PeekCqe( URING_Ring* ring );
+
+/**
+ * Releases the completion returned by URING_PeekCqe()
+ */
+void URING_SeenCqe( URING_Ring* ring );
+
+/**
+ * return values:
+ *  the provided buffer with the given id
+ */
+char* URING_Buffer( URING_Ring* ring, uint16_t bid );
+
+/**
+ * Gives a provided buffer back to the kernel
+ */
+void URING_ReturnBuffer( URING_Ring* ring, uint16_t bid );
+
+/**
+ * Destroys the rings and the provided buffers
+ */
+void URING_Exit( URING_Ring* ring );
+
+#endif /* _URING_H_ */
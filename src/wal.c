@@ -0,0 +1,613 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "wal.h"
+
+/**************************************************************/
+/* ------------------- symbolic constants ------------------- */
+/**************************************************************/
+
+/* record layout: crc32 (4 bytes), key length, value length, key, value */
+#define WAL_RECORD_HEADER_SIZE      6u
+
+/* maximum size of a record */
+#define WAL_MAX_RECORD_SIZE         (WAL_RECORD_HEADER_SIZE + 2u * UINT8_MAX)
+
+/* initial size of the batch buffer */
+#define WAL_BATCH_SIZE              4096u
+
+/* CRC-32 (IEEE 802.3) polynomial, reflected */
+#define WAL_CRC32_POLY              0xEDB88320u
+
+/**************************************************************/
+/* ------------------- module local variables --------------- */
+/**************************************************************/
+
+static int logFd = -1;
+static char* logFileName = NULL;
+static uint64_t logSize = 0;
+static uint8_t syncPolicy = WAL_SYNC_ALWAYS;
+static uint32_t syncIntervalMs = 0;
+
+/* records appended since the last commit */
+static uint8_t* batchBuf = NULL;
+static size_t batchLen = 0;
+static size_t batchSize = 0;
+
+/* batch being written by the leader of a group commit */
+static uint8_t* flushBuf = NULL;
+static size_t flushSize = 0;
+static _Bool flushing = false;
+
+/* written but not yet synced records */
+static _Bool unsynced = false;
+static uint64_t lastSyncMs = 0;
+
+/* positions in the stream of records (they are not reset by a rotation) */
+static uint64_t appendedPos = 0;
+static uint64_t writtenPos = 0;
+static uint64_t syncedPos = 0;
+
+/* end of the last record appended by the thread */
+static __thread uint64_t threadPos = 0;
+
+/* every variable above is protected by the lock, except while a leader is flushing */
+static pthread_mutex_t walLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flushDone = PTHREAD_COND_INITIALIZER;
+
+static uint32_t crcTable[256];
+static _Bool crcTableReady = false;
+
+/**************************************************************/
+/* ------------------- function prototypes ------------------ */
+/**************************************************************/
+
+static void initCrcTable( void );
+static uint32_t crc32( const uint8_t* data, size_t len );
+static uint64_t monotonicMs( void );
+static _Bool writeAll( int fd, const uint8_t* buf, size_t len );
+static uint8_t syncLog( void );
+static _Bool commitNeeded( uint64_t pos );
+static uint8_t flushBatch( void );
+
+/**************************************************************/
+/* ------------------- local functions ---------------------- */
+/**************************************************************/
+
+/**
+ * @brief Fills the CRC-32 lookup table
+ *
+ * @return     none
+ */
+static void initCrcTable( void )
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t entry = i;
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            entry = (entry & 1u) ? ((entry >> 1) ^ WAL_CRC32_POLY) : (entry >> 1);
+        }
+        crcTable[i] = entry;
+    }
+    crcTableReady = true;
+}
+
+/**
+ * @brief Calculates the CRC-32 of a buffer
+ *
+ * @param[in]  data
+ * @param[in]  len
+ * @return     checksum
+ */
+static uint32_t crc32( const uint8_t* data, size_t len )
+{
+    uint32_t crc = 0xFFFFFFFFu;
+
+    if (!crcTableReady)
+    {
+        initCrcTable();
+    }
+
+    while (len--)
+    {
+        crc = crcTable[(crc ^ *data++) & 0xFFu] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xFFFFFFFFu;
+}
+
+/**
+ * @brief Returns the time of the monotonic clock
+ *
+ * @return     milliseconds
+ */
+static uint64_t monotonicMs( void )
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000u + now.tv_nsec / 1000000u;
+}
+
+/**
+ * @brief Writes the whole buffer to a file
+ *
+ * @param[in]  fd
+ * @param[in]  buf
+ * @param[in]  len
+ * @return     true if every byte has been written
+ */
+static _Bool writeAll( int fd, const uint8_t* buf, size_t len )
+{
+    while (len > 0)
+    {
+        ssize_t nbytes = write(fd, buf, len);
+
+        if (nbytes < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        buf += nbytes;
+        len -= nbytes;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Flushes the written records to the storage
+ *
+ * @return     WAL_OK
+ *             WAL_ERR_WRITE
+ */
+static uint8_t syncLog( void )
+{
+    if (fdatasync(logFd) != 0)
+    {
+        return WAL_ERR_WRITE;
+    }
+
+    unsynced = false;
+    lastSyncMs = monotonicMs();
+    syncedPos = writtenPos;
+
+    return WAL_OK;
+}
+
+/**
+ * @brief Checks whether the records till the given position still have to be committed
+ *
+ * Called with the lock held.
+ *
+ * @param[in]  pos end of the records of the caller
+ * @return     true if they are not written (or not synced) as the policy requires,
+ *             or an interval sync is due
+ */
+static _Bool commitNeeded( uint64_t pos )
+{
+    if (((syncPolicy == WAL_SYNC_ALWAYS) ? syncedPos : writtenPos) < pos)
+    {
+        return true;
+    }
+
+    return unsynced && (syncPolicy == WAL_SYNC_INTERVAL) && (monotonicMs() - lastSyncMs >= syncIntervalMs);
+}
+
+/**
+ * @brief Writes the current batch and syncs it as the leader of a group commit
+ *
+ * Called with the lock held and no other flush in progress. The batch is
+ * swapped with the flush buffer and the lock is released during the write
+ * and the sync, so the other threads can append the records of the next
+ * group meanwhile.
+ *
+ * @return     WAL_OK
+ *             WAL_ERR_WRITE
+ */
+static uint8_t flushBatch( void )
+{
+    uint8_t* buf = batchBuf;
+    size_t len = batchLen;
+    size_t size = batchSize;
+    uint64_t endPos = appendedPos;
+    _Bool sync = (syncPolicy == WAL_SYNC_ALWAYS)
+              || ((syncPolicy == WAL_SYNC_INTERVAL) && (monotonicMs() - lastSyncMs >= syncIntervalMs));
+    _Bool written;
+    _Bool synced = false;
+
+    batchBuf = flushBuf;
+    batchSize = flushSize;
+    batchLen = 0;
+    flushBuf = buf;
+    flushSize = size;
+    sync = sync && (unsynced || (len != 0));
+    flushing = true;
+
+    pthread_mutex_unlock(&walLock);
+
+    written = (len == 0) || writeAll(logFd, buf, len);
+    if (written && sync)
+    {
+        synced = (fdatasync(logFd) == 0);
+    }
+
+    pthread_mutex_lock(&walLock);
+
+    flushing = false;
+    pthread_cond_broadcast(&flushDone);
+
+    if (!written || (sync && !synced))
+    {
+        return WAL_ERR_WRITE;
+    }
+
+    logSize += len;
+    writtenPos = endPos;
+    unsynced = unsynced || (len != 0);
+    if (synced)
+    {
+        unsynced = false;
+        lastSyncMs = monotonicMs();
+        syncedPos = endPos;
+    }
+
+    return WAL_OK;
+}
+
+/**************************************************************/
+/* ------------------- module interfaces -------------------- */
+/**************************************************************/
+
+/**
+ * @brief Replays the records of the log
+ *
+ * Records are read until the end of the file or the first record which is
+ * incomplete or has an invalid checksum. Such a record can only be the
+ * result of an interrupted write, so the log is truncated there and
+ * new records are appended after the last valid one.
+ *
+ * @param[in]  fileName name of the log file
+ * @param[in]  apply callback for each valid record
+ * @param[out] nrOfRecords number of replayed records
+ * @return     WAL_OK
+ *             WAL_ERR_OPEN
+ */
+uint8_t WAL_Replay( const char* fileName, WAL_ReplayFunc apply, uint32_t* nrOfRecords )
+{
+    uint8_t record[WAL_MAX_RECORD_SIZE];
+    off_t validSize = 0;
+    FILE* logFile;
+
+    *nrOfRecords = 0;
+
+    if ((logFile = fopen(fileName, "r")) == NULL)
+    {
+        return (errno == ENOENT) ? WAL_OK : WAL_ERR_OPEN;
+    }
+
+    while (fread(record, 1, WAL_RECORD_HEADER_SIZE, logFile) == WAL_RECORD_HEADER_SIZE)
+    {
+        uint32_t crc;
+        uint8_t keyLen = record[4];
+        uint8_t valLen = record[5];
+
+        if (fread(record + WAL_RECORD_HEADER_SIZE, 1, keyLen + valLen, logFile) != (size_t)(keyLen + valLen))
+        {
+            break;
+        }
+
+        memcpy(&crc, record, sizeof(crc));
+        if (crc != crc32(record + sizeof(crc), WAL_RECORD_HEADER_SIZE - sizeof(crc) + keyLen + valLen))
+        {
+            break;
+        }
+
+        apply((const char*) record + WAL_RECORD_HEADER_SIZE, keyLen,
+              (const char*) record + WAL_RECORD_HEADER_SIZE + keyLen, valLen);
+
+        validSize += WAL_RECORD_HEADER_SIZE + keyLen + valLen;
+        (*nrOfRecords)++;
+    }
+
+    fclose(logFile);
+
+    /* cut off the torn tail (if any) */
+    if (truncate(fileName, validSize) != 0)
+    {
+        return WAL_ERR_OPEN;
+    }
+
+    return WAL_OK;
+}
+
+/**
+ * @brief Opens the log for appending
+ *
+ * @param[in]  fileName name of the log file
+ * @param[in]  policy fsync policy (WAL_SYNC_ALWAYS, WAL_SYNC_INTERVAL, WAL_SYNC_NEVER)
+ * @param[in]  intervalMs sync interval of WAL_SYNC_INTERVAL
+ * @return     WAL_OK
+ *             WAL_ERR_OPEN
+ */
+uint8_t WAL_Open( const char* fileName, uint8_t policy, uint32_t intervalMs )
+{
+    struct stat logStat;
+
+    if ((logFd = open(fileName, O_WRONLY | O_CREAT | O_APPEND, 0644)) < 0)
+    {
+        return WAL_ERR_OPEN;
+    }
+
+    if ((fstat(logFd, &logStat) != 0) || ((logFileName = malloc(strlen(fileName) + 1)) == NULL))
+    {
+        close(logFd);
+        logFd = -1;
+        return WAL_ERR_OPEN;
+    }
+    sprintf(logFileName, "%s", fileName);
+    logSize = logStat.st_size;
+
+    /* the table is filled before the threads start appending records */
+    if (!crcTableReady)
+    {
+        initCrcTable();
+    }
+
+    syncPolicy = policy;
+    syncIntervalMs = intervalMs;
+    unsynced = false;
+    lastSyncMs = monotonicMs();
+    batchLen = 0;
+    writtenPos = appendedPos;
+    syncedPos = appendedPos;
+
+    return WAL_OK;
+}
+
+/**
+ * @brief Adds a PUT record to the current batch
+ *
+ * @param[in]  key
+ * @param[in]  keyLen
+ * @param[in]  value
+ * @param[in]  valLen
+ * @return     WAL_OK
+ *             WAL_ERR_NO_MEM
+ */
+uint8_t WAL_Append( const char* key, uint8_t keyLen, const char* value, uint8_t valLen )
+{
+    uint8_t record[WAL_MAX_RECORD_SIZE];
+    size_t recordLen = WAL_RECORD_HEADER_SIZE + keyLen + valLen;
+    uint32_t crc;
+
+    /* the record is built without the lock */
+    record[4] = keyLen;
+    record[5] = valLen;
+    memcpy(record + WAL_RECORD_HEADER_SIZE, key, keyLen);
+    memcpy(record + WAL_RECORD_HEADER_SIZE + keyLen, value, valLen);
+
+    crc = crc32(record + sizeof(crc), recordLen - sizeof(crc));
+    memcpy(record, &crc, sizeof(crc));
+
+    pthread_mutex_lock(&walLock);
+
+    if (batchLen + recordLen > batchSize)
+    {
+        size_t newSize = (batchSize == 0) ? WAL_BATCH_SIZE : (batchSize * 2);
+        uint8_t* newBuf = realloc(batchBuf, newSize);
+
+        if (newBuf == NULL)
+        {
+            pthread_mutex_unlock(&walLock);
+            return WAL_ERR_NO_MEM;
+        }
+        batchBuf = newBuf;
+        batchSize = newSize;
+    }
+
+    memcpy(batchBuf + batchLen, record, recordLen);
+    batchLen += recordLen;
+    appendedPos += recordLen;
+    threadPos = appendedPos;
+
+    pthread_mutex_unlock(&walLock);
+
+    return WAL_OK;
+}
+
+/**
+ * @brief Commits the records appended by the calling thread
+ *
+ * The caller commits once per batch window (e.g. per event loop round).
+ * Threads commit in groups: the first one becomes the leader and writes
+ * every appended record with one write and at most one fsync, the others
+ * wait till their records have been committed by a leader. A thread
+ * becomes the next leader if its records are not covered yet.
+ *
+ * @return     WAL_OK
+ *             WAL_ERR_WRITE
+ */
+uint8_t WAL_Commit( void )
+{
+    uint8_t retVal = WAL_OK;
+
+    pthread_mutex_lock(&walLock);
+
+    while ((logFd >= 0) && (retVal == WAL_OK) && commitNeeded(threadPos))
+    {
+        if (flushing)
+        {
+            pthread_cond_wait(&flushDone, &walLock);
+        }
+        else
+        {
+            retVal = flushBatch();
+        }
+    }
+
+    pthread_mutex_unlock(&walLock);
+
+    return retVal;
+}
+
+/**
+ * @brief Moves the committed records to an other file and starts a new log
+ *
+ * The pending records are committed and synced first, so the rotated
+ * file contains every record appended so far.
+ *
+ * @param[in]  rotatedName new name of the current log file
+ * @return     WAL_OK
+ *             WAL_ERR_WRITE (the current log is kept)
+ *             WAL_ERR_OPEN (the new log can't be created)
+ */
+uint8_t WAL_Rotate( const char* rotatedName )
+{
+    uint8_t retVal = WAL_OK;
+
+    pthread_mutex_lock(&walLock);
+
+    /* the log is not written by a leader while it is renamed */
+    while (flushing)
+    {
+        pthread_cond_wait(&flushDone, &walLock);
+    }
+
+    if (logFd < 0)
+    {
+        pthread_mutex_unlock(&walLock);
+        return WAL_ERR_OPEN;
+    }
+
+    if ((batchLen != 0) && !writeAll(logFd, batchBuf, batchLen))
+    {
+        pthread_mutex_unlock(&walLock);
+        return WAL_ERR_WRITE;
+    }
+    logSize += batchLen;
+    batchLen = 0;
+    writtenPos = appendedPos;
+
+    if ((syncLog() != WAL_OK) || (rename(logFileName, rotatedName) != 0))
+    {
+        pthread_mutex_unlock(&walLock);
+        return WAL_ERR_WRITE;
+    }
+
+    close(logFd);
+
+    if ((logFd = open(logFileName, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644)) < 0)
+    {
+        retVal = WAL_ERR_OPEN;
+    }
+    logSize = 0;
+
+    pthread_mutex_unlock(&walLock);
+
+    return retVal;
+}
+
+/**
+ * @brief Returns the size of the log file
+ *
+ * @return     size of the committed records in bytes
+ */
+uint64_t WAL_Size( void )
+{
+    uint64_t size;
+
+    pthread_mutex_lock(&walLock);
+    size = logSize;
+    pthread_mutex_unlock(&walLock);
+
+    return size;
+}
+
+/**
+ * @brief Returns the time until the next sync of the log is due
+ *
+ * @return     milliseconds until the next sync
+ *             -1 if no sync is pending
+ */
+int WAL_SyncTimeout( void )
+{
+    int timeout = -1;
+
+    pthread_mutex_lock(&walLock);
+
+    if ((logFd >= 0) && unsynced && (syncPolicy == WAL_SYNC_INTERVAL))
+    {
+        uint64_t elapsed = monotonicMs() - lastSyncMs;
+
+        timeout = (elapsed >= syncIntervalMs) ? 0 : (int)(syncIntervalMs - elapsed);
+    }
+
+    pthread_mutex_unlock(&walLock);
+
+    return timeout;
+}
+
+/**
+ * @brief Commits the pending records, syncs and closes the log
+ *
+ * @return     none
+ */
+void WAL_Close( void )
+{
+    if (logFd < 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&walLock);
+
+    while (flushing)
+    {
+        pthread_cond_wait(&flushDone, &walLock);
+    }
+
+    if (batchLen != 0)
+    {
+        writeAll(logFd, batchBuf, batchLen);
+        batchLen = 0;
+    }
+    fdatasync(logFd);
+    close(logFd);
+    logFd = -1;
+
+    pthread_mutex_unlock(&walLock);
+
+    free(logFileName);
+    logFileName = NULL;
+}
@@ -0,0 +1,100 @@
+#ifndef _WAL_H_
+#define _WAL_H_
+
+#include <stdint.h>
+
+/** Return values of this module */
+#define WAL_OK              0u
+#define WAL_ERR_OPEN        1u
+#define WAL_ERR_WRITE       2u
+#define WAL_ERR_NO_MEM      3u
+
+/**
+ * fsync policies of the log
+ *  - WAL_SYNC_ALWAYS   : every commit is synced before it returns
+ *  - WAL_SYNC_INTERVAL : the log is synced at most once per interval
+ *  - WAL_SYNC_NEVER    : syncing is left to the OS
+ */
+#define WAL_SYNC_ALWAYS     0u
+#define WAL_SYNC_INTERVAL   1u
+#define WAL_SYNC_NEVER      2u
+
+/*
+ * WAL_Append(), WAL_Commit(), WAL_Rotate(), WAL_Size() and WAL_SyncTimeout()
+ * can be called from several threads, the others only at startup/shutdown.
+ */
+
+/**
+ * callback of WAL_Replay(), called for each record of the log in order
+ */
+typedef void (*WAL_ReplayFunc)( const char* key, uint8_t keyLen, const char* value, uint8_t valLen );
+
+/**
+ * Replays the log, a torn record at the end of the log (e.g. after a crash)
+ * is cut off; a missing log is treated as empty
+ *
+ * return values:
+ *  WAL_OK
+ *  WAL_ERR_OPEN
+ */
+uint8_t WAL_Replay( const char* fileName, WAL_ReplayFunc apply, uint32_t* nrOfRecords );
+
+/**
+ * Opens (or creates) the log for appending
+ *
+ * return values:
+ *  WAL_OK
+ *  WAL_ERR_OPEN
+ */
+uint8_t WAL_Open( const char* fileName, uint8_t syncPolicy, uint32_t syncIntervalMs );
+
+/**
+ * Adds a PUT record to the current batch, it is written by WAL_Commit()
+ *
+ * return values:
+ *  WAL_OK
+ *  WAL_ERR_NO_MEM
+ */
+uint8_t WAL_Append( const char* key, uint8_t keyLen, const char* value, uint8_t valLen );
+
+/**
+ * Commits the records appended by the calling thread: the batch is written
+ * with one write and synced according to the sync policy, so every record
+ * of the batch (appended by any thread) shares a single fsync
+ *
+ * return values:
+ *  WAL_OK
+ *  WAL_ERR_WRITE
+ */
+uint8_t WAL_Commit( void );
+
+/**
+ * Renames the current log (after committing and syncing it) and
+ * continues with a new, empty log under the original name
+ *
+ * return values:
+ *  WAL_OK
+ *  WAL_ERR_WRITE
+ *  WAL_ERR_OPEN
+ */
+uint8_t WAL_Rotate( const char* rotatedName );
+
+/**
+ * return values:
+ *  size of the log file in bytes
+ */
+uint64_t WAL_Size( void );
+
+/**
+ * return values:
+ *  time in milliseconds until the next sync is due
+ *  -1 if no sync is pending
+ */
+int WAL_SyncTimeout( void );
+
+/**
+ * Syncs and closes the log
+ */
+void WAL_Close( void );
+
+#endif /* _WAL_H_ */
@@ -0,0 +1,94 @@
+#!/bin/bash
+#
+# Binary protocol (see inc/protocol.h): hello, GET, PUT, an unknown opcode,
+# a value with a line end and a frame split among writes, the replies are
+# compared byte by byte.
+#
+# usage: binary_protocol.sh server registry_file [backend]
+
+export LC_ALL=C
+
+SERVER=$1
+REGISTRY=$2
+BACKEND=${3:-epoll}
+PORT=$((20000 + RANDOM % 20000))
+
+"$SERVER" -p "$PORT" -f "$REGISTRY" -b "$BACKEND" >/dev/null &
+PID=$!
+REQUESTS=$(mktemp)
+trap 'kill $PID 2>/dev/null; rm -f $REQUESTS' EXIT
+
+# wait till the server listens
+for i in $(seq 50); do
+    (exec 3<>/dev/tcp/127.0.0.1/$PORT) 2>/dev/null && break
+    sleep 0.1
+done
+
+# frame opcode request_id key [value], the request id is sent little endian
+frame()
+{
+    printf "\\x$(printf '%02x' "$1")\\x00\\x$(printf '%02x' ${#3})\\x$(printf '%02x' ${#4})"
+    printf "\\x$(printf '%02x' "$2")\\x00\\x00\\x00"
+    printf '%s%s' "$3" "$4"
+}
+
+# sends the requests in one write (printf may split its output)
+send()
+{
+    cat "$REQUESTS" >&3
+}
+
+exec 3<>/dev/tcp/127.0.0.1/$PORT || exit 1
+
+{
+    printf '\x80\x01'
+    frame 1 1 Angola
+    frame 2 2 BinKey1 v1
+    frame 1 3 BinKey1
+    frame 127 4
+    frame 2 5 BinKey2 $'a\nb'
+    frame 1 6 BinKey2
+} >"$REQUESTS"
+send
+
+# the first 5 bytes of a GET, the rest arrives later
+frame 1 7 Albania >"$REQUESTS"
+head -c 5 "$REQUESTS" >&3
+sleep 0.3
+{
+    tail -c +6 "$REQUESTS"
+    frame 4 8
+} >"$REQUESTS.rest"
+mv "$REQUESTS.rest" "$REQUESTS"
+send
+
+# the replies, then EOF after BYE
+REPLIES=$(timeout 2 od -An -v -tx1 <&3 | tr -d ' \n')
+STATUS=${PIPESTATUS[0]}
+exec 3>&-
+
+if [ "$STATUS" -ne 0 ]; then
+    echo "connection not closed after BYE"
+    exit 1
+fi
+
+hex()
+{
+    printf '%s' "$1" | od -An -v -tx1 | tr -d ' \n'
+}
+
+EXPECTED="8001"                                 # hello of version 1
+EXPECTED+="0100000601000000$(hex Luanda)"       # GET Angola
+EXPECTED+="0200000002000000"                    # PUT BinKey1
+EXPECTED+="0100000203000000$(hex v1)"           # GET BinKey1
+EXPECTED+="7f09000004000000"                    # unknown opcode: PROTOCOL_ST_BAD_REQUEST
+EXPECTED+="0206000005000000"                    # value with a line end: PROTOCOL_ST_VAL_INVALID
+EXPECTED+="0104000006000000"                    # GET BinKey2: PROTOCOL_ST_KEY_NOT_FOUND
+EXPECTED+="0100000f07000000$(hex 'Tirana (Tirane)')"   # GET Albania split among writes
+
+if [ "$REPLIES" != "$EXPECTED" ]; then
+    echo "unexpected replies:"
+    echo "  got      $REPLIES"
+    echo "  expected $EXPECTED"
+    exit 1
+fi
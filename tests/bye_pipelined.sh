@@ -0,0 +1,43 @@
+#!/bin/bash
+#
+# Requests pipelined ahead of 'bye' in a single write: the server must send
+# their replies before it closes the connection.
+#
+# usage: bye_pipelined.sh server registry_file [backend]
+
+SERVER=$1
+REGISTRY=$2
+BACKEND=${3:-epoll}
+PORT=$((20000 + RANDOM % 20000))
+
+"$SERVER" -p "$PORT" -f "$REGISTRY" -b "$BACKEND" >/dev/null &
+PID=$!
+REQUESTS=$(mktemp)
+trap 'kill $PID 2>/dev/null; rm -f $REQUESTS' EXIT
+
+# wait till the server listens
+for i in $(seq 50); do
+    (exec 3<>/dev/tcp/127.0.0.1/$PORT) 2>/dev/null && break
+    sleep 0.1
+done
+
+# printf may split its output, cat sends the requests in one write
+printf 'GET Angola\nGET Albania\nbye\n' >"$REQUESTS"
+exec 3<>/dev/tcp/127.0.0.1/$PORT || exit 1
+cat "$REQUESTS" >&3
+
+# the replies, then EOF
+REPLIES=$(timeout 2 cat <&3)
+STATUS=$?
+exec 3>&-
+
+if [ $STATUS -ne 0 ]; then
+    echo "connection not closed after bye"
+    exit 1
+fi
+
+EXPECTED=$(printf '[Angola] => [Luanda]\n[Albania] => [Tirana (Tirane)]')
+if [ "$REPLIES" != "$EXPECTED" ]; then
+    echo "unexpected replies: $REPLIES"
+    exit 1
+fi
@@ -0,0 +1,52 @@
+#!/bin/bash
+#
+# An MGET whose replies overflow the reply buffer of the connection, sent
+# by a client which closes the connection right away: the early commits of
+# the round fail to send, the server must drop the rest of the replies and
+# keep serving the other clients.
+#
+# usage: mget_closed_peer.sh server registry_file
+
+SERVER=$1
+REGISTRY=$2
+PORT=$((20000 + RANDOM % 20000))
+
+"$SERVER" -p "$PORT" -f "$REGISTRY" >/dev/null &
+PID=$!
+trap 'kill $PID 2>/dev/null' EXIT
+
+# wait till the server listens
+for i in $(seq 50); do
+    (exec 3<>/dev/tcp/127.0.0.1/$PORT) 2>/dev/null && break
+    sleep 0.1
+done
+
+# one request of the maximum length, every key gets a reply line
+LINE="MGET"
+KEY=0
+while [ ${#LINE} -lt 2040 ]; do
+    LINE="$LINE k$KEY"
+    KEY=$((KEY + 1))
+done
+
+for i in 1 2 3 4; do
+    exec 3<>/dev/tcp/127.0.0.1/$PORT || exit 1
+    printf '%s\n' "$LINE" >&3
+    exec 3>&-
+done
+
+sleep 0.5
+if ! kill -0 $PID 2>/dev/null; then
+    echo "server died"
+    exit 1
+fi
+
+exec 3<>/dev/tcp/127.0.0.1/$PORT || exit 1
+printf 'MGET k1\n' >&3
+read -t 2 -r REPLY <&3
+exec 3>&-
+
+if [ "$REPLY" != "Key [k1] not found in regisry" ]; then
+    echo "unexpected reply: $REPLY"
+    exit 1
+fi
@@ -0,0 +1,89 @@
+#!/bin/bash
+#
+# Write-ahead log with a torn last record: the server is killed after some
+# PUTs, the log is cut in the middle of its last record and the server is
+# restarted. The complete records must be replayed, the torn one must be
+# cut off, and the PUTs after the restart must be appended to the valid part.
+#
+# usage: wal_torn_tail.sh server registry_file
+
+SERVER=$1
+REGISTRY=$2
+DIR=$(mktemp -d)
+LOG=$DIR/wal.log
+PID=
+
+trap 'stop; rm -rf $DIR' EXIT
+
+# a new port each time, the connections closed by the server keep the old one busy
+start()
+{
+    PORT=$((20000 + RANDOM % 20000))
+    "$SERVER" -p "$PORT" -f "$REGISTRY" -l "$LOG" >/dev/null &
+    PID=$!
+
+    # wait till the server listens
+    for i in $(seq 50); do
+        (exec 3<>/dev/tcp/127.0.0.1/$PORT) 2>/dev/null && return 0
+        sleep 0.1
+    done
+    echo "server not started"
+    exit 1
+}
+
+# a crash, nothing is flushed at exit
+stop()
+{
+    { kill -9 $PID; wait $PID; } 2>/dev/null
+}
+
+# sends the requests in one write, the replies are returned after 'bye'
+request()
+{
+    printf "$1bye\n" >"$DIR/requests"
+    exec 3<>/dev/tcp/127.0.0.1/$PORT || exit 1
+    cat "$DIR/requests" >&3
+    timeout 2 cat <&3
+    exec 3>&-
+}
+
+check()
+{
+    if [ "$1" != "$2" ]; then
+        echo "unexpected replies:"
+        echo "$1"
+        exit 1
+    fi
+}
+
+# every record is acknowledged after it has been written to the log
+start
+check "$(request 'PUT WalKey1 v1\nPUT WalKey2 v2\nPUT WalKey3 v3\n')" \
+      "$(printf '[WalKey1] <= [v1]\n[WalKey2] <= [v2]\n[WalKey3] <= [v3]')"
+stop
+
+# a record is a 6 byte header, the key and the value
+SIZE=$(stat -c %s "$LOG")
+if [ "$SIZE" -ne $((3 * (6 + 7 + 2))) ]; then
+    echo "unexpected log size $SIZE"
+    exit 1
+fi
+truncate -s $((SIZE - 4)) "$LOG"
+
+start
+check "$(request 'GET WalKey1\nGET WalKey2\nGET WalKey3\n')" \
+      "$(printf '[WalKey1] => [v1]\n[WalKey2] => [v2]\nKey [WalKey3] not found in regisry')"
+
+SIZE=$(stat -c %s "$LOG")
+if [ "$SIZE" -ne $((2 * (6 + 7 + 2))) ]; then
+    echo "torn tail not cut off, log size $SIZE"
+    exit 1
+fi
+
+# the record after the cut is replayed by the next restart
+check "$(request 'PUT WalKey3 v4\n')" "[WalKey3] <= [v4]"
+stop
+
+start
+check "$(request 'GET WalKey1\nGET WalKey2\nGET WalKey3\n')" \
+      "$(printf '[WalKey1] => [v1]\n[WalKey2] => [v2]\n[WalKey3] => [v4]')"